@@ -0,0 +1,45 @@
+#include "alloc_check.h"
+
+#ifdef CHECK_ALLOCATIONS
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+
+namespace {
+    thread_local size_t counted = 0;
+    thread_local int exempt = 0;
+}
+
+void* operator new(size_t size) {
+    if(exempt == 0) ++counted;
+    if(void *p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    std::free(p);
+}
+
+AllocationCheck::AllocationCheck() : start(counted) {}
+
+size_t AllocationCheck::allocations() const {
+    return counted - start;
+}
+
+void AllocationCheck::expect_none(const char *what) const {
+    size_t n = allocations();
+    if(n > 0) throw std::logic_error(std::string(what) + " allocated " + std::to_string(n) + " times");
+}
+
+AllocationCheck::Exempt::Exempt() {
+    ++exempt;
+}
+
+AllocationCheck::Exempt::~Exempt() {
+    --exempt;
+}
+#endif
@@ -0,0 +1,38 @@
+#ifndef _ALLOC_CHECK_H
+#define _ALLOC_CHECK_H
+
+#include <cstddef>
+#include <string>
+
+// Counts the heap allocations made on this thread while it exists, when the program is built with
+// -DCHECK_ALLOCATIONS, so code that shouldn't allocate can prove it. Otherwise it does nothing.
+class AllocationCheck {
+public:
+    AllocationCheck();
+
+    size_t allocations() const;
+    // Throws if anything was allocated since construction, naming what was checked
+    void expect_none(const char *what) const;
+
+    // Allocations while one of these exists aren't counted, for growth that is expected
+    class Exempt {
+    public:
+        Exempt();
+        ~Exempt();
+        Exempt(const Exempt &) = delete;
+        Exempt &operator=(const Exempt &) = delete;
+    };
+
+private:
+    size_t start;
+};
+
+#ifndef CHECK_ALLOCATIONS
+inline AllocationCheck::AllocationCheck() : start(0) {}
+inline size_t AllocationCheck::allocations() const { return 0; }
+inline void AllocationCheck::expect_none(const char *) const {}
+inline AllocationCheck::Exempt::Exempt() {}
+inline AllocationCheck::Exempt::~Exempt() {}
+#endif
+
+#endif //_ALLOC_CHECK_H
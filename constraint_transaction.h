@@ -0,0 +1,89 @@
+#ifndef _CONSTRAINT_TRANSACTION_H
+#define _CONSTRAINT_TRANSACTION_H
+
+#include <vector>
+#include <algorithm>
+#include <initializer_list>
+
+// A group of constraints, such as everything learned from one move, for an engine to commit at
+// once. The engine checks them all in a single pass over its configurations and deduces once.
+// Clearing keeps the storage of every constraint, so a transaction reused for each move stops
+// allocating once it has held its largest move.
+template<class key_type, class state_type>
+class ConstraintTransaction {
+public:
+    enum KIND { ALL_OF, NONE_OF, ONE_OF, AT_LEAST_ONE_OF, COUNT };
+
+    class Constraint {
+    public:
+        KIND kind;
+        std::vector<key_type> keys; // sorted and distinct
+        state_type state;
+        int min, max; // bounds of a COUNT
+    };
+
+    ConstraintTransaction() : used(0) {}
+
+    template<class Keys>
+    void constrain_none_of(const Keys &keys, const state_type &state) {
+        add(NONE_OF, keys.begin(), keys.end(), state, 0, 0);
+    }
+
+    template<class Keys>
+    void constrain_all_of(const Keys &keys, const state_type &state) {
+        add(ALL_OF, keys.begin(), keys.end(), state, 0, 0);
+    }
+
+    template<class Keys>
+    void constrain_one_of(const Keys &keys, const state_type &state) {
+        add(ONE_OF, keys.begin(), keys.end(), state, 0, 0);
+    }
+
+    template<class Keys>
+    void constrain_at_least_one_of(const Keys &keys, const state_type &state) {
+        add(AT_LEAST_ONE_OF, keys.begin(), keys.end(), state, 0, 0);
+    }
+
+    void constrain_all_of(std::initializer_list<key_type> keys, const state_type &state) {
+        add(ALL_OF, keys.begin(), keys.end(), state, 0, 0);
+    }
+
+    void constrain_one_of(const state_type &state) {
+        constrain_count(state, 1, 1);
+    }
+
+    void constrain_count(const state_type &state, int min, int max) {
+        const key_type *none = nullptr;
+        add(COUNT, none, none, state, min, max);
+    }
+
+    // Makes room for that many constraints of up to that many keys each
+    void reserve(size_t num_constraints, size_t num_keys) {
+        if(constraints.size() < num_constraints) constraints.resize(num_constraints);
+        for(Constraint &c : constraints) c.keys.reserve(num_keys);
+    }
+
+    const Constraint *begin() const { return constraints.data(); }
+    const Constraint *end() const { return constraints.data() + used; }
+    bool empty() const { return used == 0; }
+    void clear() { used = 0; }
+
+private:
+    std::vector<Constraint> constraints; // the first used of them are live
+    size_t used;
+
+    template<class Iterator>
+    void add(KIND kind, Iterator first, Iterator last, const state_type &state, int min, int max) {
+        if(used == constraints.size()) constraints.emplace_back();
+        Constraint &c = constraints[used++];
+        c.kind = kind;
+        c.keys.assign(first, last);
+        std::sort(c.keys.begin(), c.keys.end());
+        c.keys.erase(std::unique(c.keys.begin(), c.keys.end()), c.keys.end());
+        c.state = state;
+        c.min = min;
+        c.max = max;
+    }
+};
+
+#endif //_CONSTRAINT_TRANSACTION_H
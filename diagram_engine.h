@@ -0,0 +1,626 @@
+#ifndef _DIAGRAM_ENGINE_H
+#define _DIAGRAM_ENGINE_H
+
+#include <iostream>
+#include <utility>
+#include <algorithm>
+#include <vector>
+#include <set>
+#include <map>
+#include <unordered_map>
+#include <cmath>
+#include <climits>
+#include <cassert>
+#include "logic_engine.h"
+
+// Gives the same answers as LogicEngine, but stores the configurations as a quasi-reduced
+// multi-valued decision diagram instead of a tree. Identical subtrees are one hash-consed node,
+// so memory grows with the number of distinct constraint interactions, not surviving worlds.
+template<class key_type, class state_type>
+class DiagramEngine {
+public:
+    DiagramEngine() : root(FALSE_NODE), live_nodes(0) {}
+
+    DiagramEngine(const std::set<state_type> &possible_states_) : possible_states(possible_states_),
+        states(possible_states_.begin(), possible_states_.end()), root(TRUE_NODE) {
+        for(int i = 0; i < 2; ++i) { // the FALSE and TRUE terminals
+            node_var.push_back(-1);
+            edges.insert(edges.end(), states.size(), FALSE_NODE);
+            node_weight.push_back(i);
+        }
+        table.assign(1024, -1);
+        live_nodes = 2;
+    }
+
+    bool find_by_state(const state_type &state, key_type &key) {
+        for(const auto &pair : known) {
+            if(pair.second == state) {
+                key = pair.first;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool is_true(const key_type &key, const state_type &state) {
+        auto itr = known.find(key);
+        if(itr == known.end()) return false;
+        return itr->second == state;
+    }
+
+    bool highest_prob(const std::vector<state_type> &states_, key_type &key) {
+        if(configs.empty()) return false;
+        const double *counts = marginals();
+        double highestCount = 0;
+        for(const auto &config : configs) { // loop over keys
+            double count = 0;
+            for(int i = 0; i < (int)states.size(); ++i) {
+                for(const state_type &state : states_) {
+                    if(state == states[i]) {
+                        count += counts[config.second * states.size() + i];
+                        break;
+                    }
+                }
+            }
+            if(count > highestCount * (1 + 1e-12)) { // within rounding is a tie, which the first key wins
+                highestCount = count;
+                key = config.first;
+            }
+        }
+        return highestCount > 0;
+    }
+
+    // Calls visit(key, i, odds) with the chance that each key not yet known is in states[i],
+    // all read from one pass of marginal counts
+    template<class Visit>
+    void for_each_odds(const std::vector<state_type> &states_, Visit visit) {
+        if(configs.empty()) return;
+        const double *counts = marginals();
+        for(const auto &config : configs) {
+            for(int i = 0; i < (int)states_.size(); ++i) {
+                auto itr = std::lower_bound(states.begin(), states.end(), states_[i]);
+                double count = itr != states.end() && *itr == states_[i] ?
+                    counts[config.second * states.size() + (itr - states.begin())] : 0;
+                visit(config.first, i, count / node_weight[root]);
+            }
+        }
+    }
+
+    // Every key in the order it was set known, so callers can catch up on what changed
+    const std::vector<key_type> &known_order() const {
+        return known_log;
+    }
+
+    void set_known(const key_type &key, const state_type &state) {
+        check_usable();
+        if(possible_states.find(state) == possible_states.end()) illegal_state();
+        auto known_itr = known.find(key);
+        if(known_itr != known.end()) {
+            int i = tracked_index(known_itr->second);
+            if(i >= 0) --known_tally[i];
+        }
+        int i = tracked_index(state);
+        if(i >= 0) ++known_tally[i];
+        if(i >= 0 && known_tally[i] > tracked[i].max) illegal_constraint();
+        AllocationCheck::Exempt growth; // restricting the diagram builds new nodes
+        remove_var(key);
+        known[key] = state;
+        known_log.push_back(key);
+        collect_garbage();
+    }
+
+    std::pair<std::set<state_type>, double> most_likely(const key_type &key) {
+        auto known_itr = known.find(key);
+        if(known_itr != known.end()) return {{known_itr->second}, 1};
+
+        auto configs_itr = configs.find(key);
+        if(configs_itr == configs.end()) return {possible_states, 1.0 / possible_states.size()};
+
+        const double *counts = marginals() + configs_itr->second * states.size();
+        double highest = *std::max_element(counts, counts + states.size());
+        std::set<state_type> likely;
+        for(int i = 0; i < (int)states.size(); ++i)
+            if(counts[i] >= highest * (1 - 1e-12)) likely.insert(states[i]); // within rounding is a tie
+        return {likely, highest / node_weight[root]};
+    }
+
+    // Requires the number of keys in the given state, known or not, to stay between min and max.
+    // The bound is remembered and enforced on every key added later, so repeating it is free.
+    void constrain_count(const state_type &state, int min, int max) {
+        check_usable();
+        if(possible_states.find(state) == possible_states.end()) illegal_state();
+        int i = track(state);
+        tracked_state &t = tracked[i];
+        if(min <= t.min && max >= t.max) return;
+        t.min = std::max(t.min, min);
+        t.max = std::min(t.max, max);
+        if(known_tally[i] > t.max) illegal_constraint();
+
+        std::vector<bool> all(var_keys.size(), true);
+        restrict_count(all, state_index(state), t.min - known_tally[i], t.max - known_tally[i]);
+        if(!committing) deduce();
+    }
+
+    void constrain_one_of(const state_type &state) {
+        constrain_count(state, 1, 1);
+    }
+
+    // Weighs every unknown key in the given state by density / (1 - density) relative to any
+    // other state, so that probabilities follow a prior instead of counting configurations evenly
+    void set_density(const state_type &state, double density) {
+        check_usable();
+        if(possible_states.find(state) == possible_states.end()) illegal_state();
+        assert(density > 0 && density < 1);
+        tracked[track(state)].odds = density / (1 - density);
+        for(int n = 2; n < (int)node_var.size(); ++n) // children always precede their parents
+            node_weight[n] = weigh(n);
+        marginals_root = -1;
+    }
+
+    void constrain_none_of(const std::set<key_type> &keys, const state_type &state) {
+        constrain_each(keys, state, false);
+    }
+
+    void constrain_all_of(const std::set<key_type> &keys, const state_type &state) {
+        constrain_each(keys, state, true);
+    }
+
+    void constrain_one_of(const std::set<key_type> &keys, const state_type &state) {
+        constrain_together(keys, state, 1, false);
+    }
+
+    void constrain_at_least_one_of(const std::set<key_type> &keys, const state_type &state) {
+        constrain_together(keys, state, 1, true);
+    }
+
+    // Applies every constraint in the transaction and deduces once. Each constraint is already a
+    // single memoized pass over the diagram, so only the deductions in between are saved. Every
+    // pass builds new nodes and caches, so all of it counts as the diagram's growth.
+    void commit(const ConstraintTransaction<key_type, state_type> &transaction) {
+        typedef ConstraintTransaction<key_type, state_type> transaction_type;
+        check_usable();
+        for(const auto &c : transaction) // before anything changes, so a bad state leaves no trace
+            if(possible_states.find(c.state) == possible_states.end()) illegal_state();
+        AllocationCheck::Exempt growth;
+        committing = true;
+        try {
+            for(const auto &c : transaction) {
+                std::set<key_type> keys(c.keys.begin(), c.keys.end());
+                if(c.kind == transaction_type::COUNT) constrain_count(c.state, c.min, c.max);
+                else if(c.kind == transaction_type::ALL_OF) constrain_each(keys, c.state, true);
+                else if(c.kind == transaction_type::NONE_OF) constrain_each(keys, c.state, false);
+                else if(c.kind == transaction_type::ONE_OF) constrain_together(keys, c.state, 1, false);
+                else constrain_together(keys, c.state, 1, true);
+            }
+        } catch(...) {
+            committing = false;
+            throw;
+        }
+        committing = false;
+        deduce();
+        collect_garbage();
+    }
+
+    void print() const {
+        std::cout << "Knowns: ------------------" << std::endl;
+        for(auto s : known)
+            std::cout << s.first << ": " << s.second << ", " << std::endl;
+        std::cout << std::endl << "Configurations: ------------------" << std::endl;
+        if(root != FALSE_NODE)
+            std::cout << configs.size() << " keys, " << node_weight[root] << " configurations, "
+                      << live_nodes << " nodes" << std::endl;
+        std::cout << "-------------------------------------------" << std::endl;
+    }
+
+private:
+    static constexpr int FALSE_NODE = 0;
+    static constexpr int TRUE_NODE = 1;
+
+    std::set<state_type> possible_states;
+    std::vector<state_type> states;
+    std::map<key_type, state_type> known;
+    std::vector<key_type> known_log;
+    std::map<key_type, int> configs; // unknown keys and their variables
+    std::vector<key_type> var_keys;
+    std::vector<int> order, position; // variables from the root down, and each one's place in it
+
+    // The diagram. Node n tests variable node_var[n] and its child for states[i] is
+    // edges[n * states.size() + i]. Every child of a node tests the next variable in order.
+    std::vector<int> node_var, edges;
+    std::vector<double> node_weight; // cached weighted count of the paths to TRUE
+    std::vector<int> table; // unique table, open addressing over node indices
+    std::unordered_map<long long, int> or_cache;
+    int root;
+    size_t live_nodes;
+    // marginals() as of marginals_root, one row of states per var. Both buffers grow with the
+    // diagram rather than on query, so asking for odds never allocates.
+    std::vector<double> marginal_counts;
+    std::vector<double> marginal_incoming;
+    int marginals_root = -1;
+    bool committing = false; // inside commit, which deduces once at the end
+
+    // A state counted along every branch, for global cardinality bounds and density priors
+    struct tracked_state {
+        state_type state;
+        int min, max;
+        double odds;
+    };
+    std::vector<tracked_state> tracked;
+    std::vector<int> known_tally;
+
+    // LOGIC FUNCTIONS
+
+    void deduce() {
+        std::vector<std::vector<bool>> support(var_keys.size(), std::vector<bool>(states.size(), false));
+        std::vector<bool> seen(node_var.size(), false);
+        std::vector<int> stack = {root};
+        while(!stack.empty()) {
+            int n = stack.back();
+            stack.pop_back();
+            if(n == TRUE_NODE || seen[n]) continue;
+            seen[n] = true;
+            for(int i = 0; i < (int)states.size(); ++i) {
+                int c = child(n, i);
+                if(c == FALSE_NODE) continue;
+                support[node_var[n]][i] = true;
+                stack.push_back(c);
+            }
+        }
+
+        std::vector<std::pair<key_type, state_type>> deduced;
+        for(const auto &config : configs) {
+            int found = -1;
+            for(int i = 0; i < (int)states.size(); ++i) {
+                if(!support[config.second][i]) continue;
+                found = found == -1 ? i : -2;
+            }
+            if(found >= 0) deduced.emplace_back(config.first, states[found]);
+        }
+        for(const auto &pair : deduced) set_known(pair.first, pair.second);
+    }
+
+    void constrain_each(const std::set<key_type> &keys, const state_type &state, bool is_equal) {
+        check_usable();
+        if(possible_states.find(state) == possible_states.end()) illegal_state();
+        for(const key_type &key : keys) {
+            auto itr = known.find(key);
+            if(itr != known.end()) {
+                if(is_equal == (itr->second != state))
+                    illegal_constraint();
+                continue;
+            }
+
+            int v = add_key(key);
+            std::vector<bool> in_set(var_keys.size(), false);
+            in_set[v] = true;
+            if(is_equal) restrict_count(in_set, state_index(state), 1, 1);
+            else restrict_count(in_set, state_index(state), 0, 0);
+        }
+        if(committing) return;
+        deduce();
+        collect_garbage();
+    }
+
+    void constrain_together(const std::set<key_type> &keys, const state_type &state, int min, bool greater) {
+        check_usable();
+        if(possible_states.find(state) == possible_states.end()) illegal_state();
+        int found = 0;
+        std::vector<int> unknowns;
+        for(const key_type &key : keys) { // loops over keys
+            auto known_itr = known.find(key);
+            if(known_itr != known.end()) { // if known
+                if(known_itr->second == state) {
+                    ++found;
+                    if(!greater && (found > min))
+                        illegal_constraint();
+                }
+            } else { // if not known
+                unknowns.push_back(add_key(key));
+            }
+        }
+
+        std::vector<bool> in_set(var_keys.size(), false);
+        for(int v : unknowns) in_set[v] = true;
+        restrict_count(in_set, state_index(state), min - found, greater ? INT_MAX : min - found);
+        if(committing) return;
+        deduce();
+        collect_garbage();
+    }
+
+    // Starts counting a state for bounds and priors and returns its index in tracked
+    int track(const state_type &state) {
+        int i = tracked_index(state);
+        if(i >= 0) return i;
+        tracked.push_back({state, 0, INT_MAX, 1});
+        int found = 0;
+        for(const auto &pair : known)
+            if(pair.second == state) ++found;
+        known_tally.push_back(found);
+        return (int)tracked.size() - 1;
+    }
+
+    int tracked_index(const state_type &state) const {
+        for(int i = 0; i < (int)tracked.size(); ++i)
+            if(tracked[i].state == state) return i;
+        return -1;
+    }
+
+    void enforce_bounds() {
+        for(int i = 0; i < (int)tracked.size(); ++i) {
+            if(tracked[i].max == INT_MAX) continue;
+            std::vector<bool> all(var_keys.size(), true);
+            restrict_count(all, state_index(tracked[i].state), INT_MIN, tracked[i].max - known_tally[i]);
+        }
+    }
+
+    // GRAPH MANIPULATION FUNCTION
+
+    int add_key(const key_type &key) {
+        auto itr = configs.find(key);
+        if(itr != configs.end()) return itr->second;
+        int v = (int)var_keys.size();
+        var_keys.push_back(key);
+        marginal_counts.resize(var_keys.size() * states.size());
+        position.push_back((int)order.size());
+        order.push_back(v);
+        configs[key] = v;
+
+        std::vector<int> children(states.size(), TRUE_NODE);
+        int bottom = make_node(v, children.data());
+        std::unordered_map<int, int> memo;
+        root = extend_rec(root, bottom, memo);
+        enforce_bounds();
+        return v;
+    }
+
+    // Hangs a copy of bottom below every path that reaches TRUE
+    int extend_rec(int n, int bottom, std::unordered_map<int, int> &memo) {
+        if(n == FALSE_NODE) return FALSE_NODE;
+        if(n == TRUE_NODE) return bottom;
+        auto itr = memo.find(n);
+        if(itr != memo.end()) return itr->second;
+        std::vector<int> children(states.size());
+        for(int i = 0; i < (int)states.size(); ++i)
+            children[i] = extend_rec(child(n, i), bottom, memo);
+        return memo[n] = make_node(node_var[n], children.data());
+    }
+
+    // Keeps only the paths on which the number of variables in in_set taking the state with
+    // index s lies between lo and hi
+    void restrict_count(const std::vector<bool> &in_set, int s, int lo, int hi) {
+        int last = -1;
+        for(int v = 0; v < (int)in_set.size(); ++v)
+            if(in_set[v] && position[v] >= 0) last = std::max(last, position[v]);
+        std::unordered_map<long long, int> memo;
+        root = restrict_rec(root, 0, in_set, s, lo, hi, last, memo);
+        if(root == FALSE_NODE) illegal_constraint();
+    }
+
+    int restrict_rec(int n, int count, const std::vector<bool> &in_set, int s, int lo, int hi, int last,
+                     std::unordered_map<long long, int> &memo) {
+        if(n == FALSE_NODE || count > hi) return FALSE_NODE;
+        if(n == TRUE_NODE || position[node_var[n]] > last) return count >= lo ? n : FALSE_NODE;
+
+        long long memo_key = ((long long)n << 32) | (unsigned)count;
+        auto itr = memo.find(memo_key);
+        if(itr != memo.end()) return itr->second;
+
+        bool counted = in_set[node_var[n]];
+        std::vector<int> children(states.size());
+        for(int i = 0; i < (int)states.size(); ++i)
+            children[i] = restrict_rec(child(n, i), count + (counted && i == s), in_set, s, lo, hi, last, memo);
+        return memo[memo_key] = make_node(node_var[n], children.data());
+    }
+
+    void remove_var(const key_type &key) {
+        auto itr = configs.find(key);
+        if(itr == configs.end()) return;
+        int v = itr->second;
+
+        bool stale = false;
+        std::unordered_map<int, int> memo;
+        root = exists_rec(root, v, stale, memo);
+
+        order.erase(order.begin() + position[v]);
+        for(int p = position[v]; p < (int)order.size(); ++p) position[order[p]] = p;
+        position[v] = -1;
+        configs.erase(itr);
+
+        // Bounds can only break if a tracked state left the diagram for the knowns
+        if(stale) enforce_bounds();
+    }
+
+    // Merges the children of every node testing v, so v no longer appears in the diagram
+    int exists_rec(int n, int v, bool &stale, std::unordered_map<int, int> &memo) {
+        if(n == FALSE_NODE || n == TRUE_NODE) return n;
+        auto itr = memo.find(n);
+        if(itr != memo.end()) return itr->second;
+
+        int result = FALSE_NODE;
+        if(node_var[n] == v) {
+            for(int i = 0; i < (int)states.size(); ++i) {
+                if(child(n, i) == FALSE_NODE) continue;
+                if(tracked_index(states[i]) >= 0) stale = true;
+                result = merge(result, child(n, i));
+            }
+        } else {
+            std::vector<int> children(states.size());
+            for(int i = 0; i < (int)states.size(); ++i)
+                children[i] = exists_rec(child(n, i), v, stale, memo);
+            result = make_node(node_var[n], children.data());
+        }
+        return memo[n] = result;
+    }
+
+    // The union of two diagrams whose roots test the same variable
+    int merge(int a, int b) {
+        if(a == FALSE_NODE) return b;
+        if(b == FALSE_NODE || a == b) return a;
+        if(a > b) std::swap(a, b);
+        long long cache_key = ((long long)a << 32) | (unsigned)b;
+        auto itr = or_cache.find(cache_key);
+        if(itr != or_cache.end()) return itr->second;
+
+        std::vector<int> children(states.size());
+        for(int i = 0; i < (int)states.size(); ++i)
+            children[i] = merge(child(a, i), child(b, i));
+        return or_cache[cache_key] = make_node(node_var[a], children.data());
+    }
+
+    // Returns the unique node testing v with the given children, creating it if needed
+    int make_node(int v, const int *children) {
+        bool all_false = true;
+        for(int i = 0; i < (int)states.size(); ++i)
+            if(children[i] != FALSE_NODE) all_false = false;
+        if(all_false) return FALSE_NODE;
+
+        size_t mask = table.size() - 1;
+        size_t slot = hash_node(v, children) & mask;
+        while(table[slot] != -1) {
+            int n = table[slot];
+            if(node_var[n] == v && std::equal(children, children + states.size(), &edges[n * states.size()]))
+                return n;
+            slot = (slot + 1) & mask;
+        }
+
+        int n = (int)node_var.size();
+        node_var.push_back(v);
+        if(marginal_incoming.capacity() < node_var.capacity()) marginal_incoming.reserve(node_var.capacity());
+        edges.insert(edges.end(), children, children + states.size());
+        node_weight.push_back(weigh(n));
+        table[slot] = n;
+        if(2 * node_var.size() > table.size()) rehash(2 * table.size());
+        return n;
+    }
+
+    size_t hash_node(int v, const int *children) const {
+        size_t h = (size_t)v * 0x9E3779B97F4A7C15ULL;
+        for(int i = 0; i < (int)states.size(); ++i)
+            h = (h ^ (size_t)children[i]) * 0x100000001B3ULL;
+        return h ^ (h >> 29);
+    }
+
+    void rehash(size_t size) {
+        table.assign(size, -1);
+        for(int n = 2; n < (int)node_var.size(); ++n) {
+            size_t slot = hash_node(node_var[n], &edges[n * states.size()]) & (size - 1);
+            while(table[slot] != -1) slot = (slot + 1) & (size - 1);
+            table[slot] = n;
+        }
+    }
+
+    // Drops unreachable nodes once they outnumber the live ones, keeping children before parents
+    void collect_garbage() {
+        if(node_var.size() < 2 * live_nodes + 4096) return;
+        std::vector<bool> reachable(node_var.size(), false);
+        reachable[FALSE_NODE] = reachable[TRUE_NODE] = true;
+        std::vector<int> stack = {root};
+        while(!stack.empty()) {
+            int n = stack.back();
+            stack.pop_back();
+            if(reachable[n]) continue;
+            reachable[n] = true;
+            for(int i = 0; i < (int)states.size(); ++i) stack.push_back(child(n, i));
+        }
+
+        std::vector<int> remap(node_var.size(), -1);
+        int size = 0;
+        for(int n = 0; n < (int)node_var.size(); ++n) {
+            if(!reachable[n]) continue;
+            remap[n] = size;
+            node_var[size] = node_var[n];
+            node_weight[size] = node_weight[n];
+            for(int i = 0; i < (int)states.size(); ++i)
+                edges[size * states.size() + i] = remap[edges[n * states.size() + i]];
+            ++size;
+        }
+        root = remap[root];
+        marginals_root = -1;
+        node_var.resize(size);
+        node_weight.resize(size);
+        edges.resize(size * states.size());
+        live_nodes = size;
+        or_cache.clear();
+
+        size_t table_size = 1024;
+        while(table_size < 2 * node_var.size()) table_size *= 2;
+        rehash(table_size);
+    }
+
+    // OTHER FUNCTIONS
+
+    int child(int n, int i) const {
+        return edges[n * states.size() + i];
+    }
+
+    int state_index(const state_type &state) const {
+        return (int)(std::lower_bound(states.begin(), states.end(), state) - states.begin());
+    }
+
+    double odds(int i) const {
+        for(const tracked_state &t : tracked)
+            if(t.state == states[i]) return t.odds;
+        return 1;
+    }
+
+    double weigh(int n) const {
+        double w = 0;
+        for(int i = 0; i < (int)states.size(); ++i)
+            if(child(n, i) != FALSE_NODE) w += odds(i) * node_weight[child(n, i)];
+        return w;
+    }
+
+    // The weighted count of configurations with each variable in each state, in one pass
+    // from the root down over the cached node counts. Kept until the diagram changes.
+    const double *marginals() {
+        double *counts = marginal_counts.data();
+        if(marginals_root == root) return counts;
+        marginals_root = root;
+        std::fill(marginal_counts.begin(), marginal_counts.end(), 0);
+        std::vector<double> &incoming = marginal_incoming;
+        incoming.assign(node_var.size(), 0);
+        incoming[root] = 1;
+        for(int n = root; n >= 2; --n) { // parents always follow their children
+            if(incoming[n] == 0) continue;
+            for(int i = 0; i < (int)states.size(); ++i) {
+                int c = child(n, i);
+                if(c == FALSE_NODE) continue;
+                incoming[c] += incoming[n] * odds(i);
+                counts[node_var[n] * states.size() + i] += incoming[n] * odds(i) * node_weight[c];
+            }
+        }
+        return counts;
+    }
+
+    // Like LogicEngine, a contradiction found halfway through a constraint releases the diagram.
+    // The knowns stay readable, but further constraints throw until the engine is reassigned.
+    void illegal_constraint() {
+        release();
+        throw LogicError("You have provided conflicting information!");
+    }
+
+    void illegal_state() {
+        throw LogicError("You provided a state that wasn't one of the possible states you specified!");
+    }
+
+    void check_usable() {
+        if(root == FALSE_NODE) throw LogicError("The logic engine was released after conflicting information!");
+    }
+
+    void release() {
+        configs.clear();
+        order.clear();
+        std::fill(position.begin(), position.end(), -1);
+        root = FALSE_NODE;
+        marginals_root = -1;
+        or_cache.clear();
+        size_t terminals = std::min<size_t>(node_var.size(), 2);
+        node_var.resize(terminals);
+        node_weight.resize(terminals);
+        edges.resize(terminals * states.size());
+        std::fill(table.begin(), table.end(), -1);
+        live_nodes = terminals;
+    }
+};
+
+#endif //_DIAGRAM_ENGINE_H
@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <cassert>
+#include "distance_field.h"
+
+void DistanceField::start(int sizeX, int sizeY) {
+    sX = sizeX;
+    sY = sizeY;
+    ox = oy = 0;
+    w = std::min(sX, MIN_WINDOW);
+    h = std::min(sY, MIN_WINDOW);
+    srcX = srcY = source = -1;
+    passable_count = 0;
+    built = false;
+    flags.assign(w * h, 0);
+    parent_dir.assign(w * h, 0);
+    dist.assign(w * h, -1);
+    order.clear();
+}
+
+void DistanceField::add_passable(int x, int y) {
+    assert(!(x < 0 || y < 0 || x >= sX || y >= sY));
+    if(!in_window(x, y)) grow_to(x, y);
+    int c = (y - oy) * w + (x - ox);
+    if(passable(c)) return;
+    flags[c] |= PASSABLE;
+    ++passable_count;
+    if((int)order.capacity() < passable_count) // room for the queries to come, while growing anyway
+        order.reserve(2 * passable_count);
+    built = false;
+}
+
+void DistanceField::set_source(int x, int y) {
+    if(x == srcX && y == srcY) return;
+    srcX = x;
+    srcY = y;
+    built = false;
+}
+
+void DistanceField::mark_visited(int x, int y) {
+    if(!in_window(x, y)) grow_to(x, y);
+    flags[(y - oy) * w + (x - ox)] |= VISITED;
+}
+
+bool DistanceField::visited(int x, int y) const {
+    return in_window(x, y) && (flags[(y - oy) * w + (x - ox)] & VISITED);
+}
+
+void DistanceField::refresh() {
+    if(!built) rebuild();
+}
+
+void DistanceField::rebuild() {
+    assert(srcX >= 0 && srcY >= 0);
+    if(!in_window(srcX, srcY)) grow_to(srcX, srcY);
+    source = (srcY - oy) * w + (srcX - ox);
+    std::fill(dist.begin(), dist.end(), -1);
+    order.clear();
+    dist[source] = 0;
+    order.push_back(source);
+    for(int i = 0; i < (int)order.size(); ++i) {
+        int u = order[i];
+        for(DIRECTION dir : directions) {
+            int v = neighbor(u, dir);
+            if(v < 0 || !passable(v) || dist[v] >= 0) continue;
+            dist[v] = dist[u] + 1;
+            parent_dir[v] = (char)dir;
+            order.push_back(v);
+        }
+    }
+    built = true;
+}
+
+// Widens the window to take in (x, y), at least doubling it in that direction so a frontier
+// spreading one cell at a time copies the arrays only a logarithmic number of times
+void DistanceField::grow_to(int x, int y) {
+    int x0 = ox, y0 = oy, x1 = ox + w, y1 = oy + h;
+    if(x < x0) x0 = std::max(0, std::min(x, ox - w));
+    if(x >= x1) x1 = std::min(sX, std::max(x + 1, ox + 2 * w));
+    if(y < y0) y0 = std::max(0, std::min(y, oy - h));
+    if(y >= y1) y1 = std::min(sY, std::max(y + 1, oy + 2 * h));
+
+    std::vector<char> moved((x1 - x0) * (y1 - y0), 0);
+    for(int j = 0; j < h; ++j)
+        for(int i = 0; i < w; ++i)
+            moved[(oy + j - y0) * (x1 - x0) + (ox + i - x0)] = flags[j * w + i];
+    flags.swap(moved);
+    ox = x0;
+    oy = y0;
+    w = x1 - x0;
+    h = y1 - y0;
+    parent_dir.assign(w * h, 0);
+    dist.assign(w * h, -1);
+    order.clear();
+    built = false;
+}
+
+bool DistanceField::in_window(int x, int y) const {
+    return !(x < ox || y < oy || x >= ox + w || y >= oy + h);
+}
+
+int DistanceField::neighbor(int c, DIRECTION dir) const {
+    int x = ox + c % w;
+    int y = oy + c / w;
+    add_direction(x, y, dir);
+    if(!in_window(x, y)) return -1;
+    return (y - oy) * w + (x - ox);
+}
+
+int DistanceField::step_back(int c) const {
+    DIRECTION dir = (DIRECTION)parent_dir[c];
+    if(dir == UP) return c - w;
+    if(dir == DOWN) return c + w;
+    if(dir == RIGHT) return c - 1;
+    return c + 1;
+}
+
+void DistanceField::add_direction(int &x, int &y, DIRECTION dir) {
+    if(dir == DIRECTION::UP) ++y;
+    else if(dir == DIRECTION::DOWN) --y;
+    else if(dir == DIRECTION::RIGHT) ++x;
+    else if(dir == DIRECTION::LEFT) --x;
+    else assert(false);
+}
@@ -0,0 +1,76 @@
+#ifndef _DISTANCE_FIELD_H
+#define _DISTANCE_FIELD_H
+
+#include <vector>
+#include "game.h"
+#include "move_buffer.h"
+
+// Breadth-first distances from one source over the cells known to be passable. The field is
+// rebuilt from scratch on the first query after the source moves or a cell becomes passable, so the robot pays
+// for one search per decision however many queries it makes there. The arrays cover a window
+// around the passable cells that grows as they spread, so memory follows the explored area
+// rather than the size of the world. The same window marks which cells the agent has stood on.
+// Once the window and the passable cells stop growing, queries reuse every buffer and don't
+// allocate.
+class DistanceField {
+public:
+    void start(int sizeX, int sizeY);
+    void add_passable(int x, int y);
+    void set_source(int x, int y);
+    int num_passable() const { return passable_count; }
+
+    void mark_visited(int x, int y);
+    bool visited(int x, int y) const;
+
+    // Finds the first cell next to the field, in breadth-first order, for which is_target
+    // is true, and fills path with the moves from the source to it
+    template<class Predicate>
+    bool find_path(const Predicate &is_target, MoveBuffer &path) {
+        refresh();
+        for(int u : order) {
+            for(DIRECTION dir : directions) {
+                int x = ox + u % w, y = oy + u / w;
+                add_direction(x, y, dir);
+                if(!is_target(x, y)) continue;
+                path.clear();
+                path.push_back(Move(false, dir));
+                for(int c = u; c != source; c = step_back(c))
+                    path.push_front(Move(false, (DIRECTION)parent_dir[c]));
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Calls visit(x, y, distance) for every cell the source reaches, nearest first
+    template<class Visit>
+    void for_each_reached(Visit visit) {
+        refresh();
+        for(int u : order) visit(ox + u % w, oy + u / w, dist[u]);
+    }
+
+private:
+    static constexpr DIRECTION directions[] = {DIRECTION::UP, DIRECTION::DOWN, DIRECTION::RIGHT, DIRECTION::LEFT};
+
+    static constexpr int MIN_WINDOW = 16;
+    enum { PASSABLE = 1, VISITED = 2 }; // bits of a cell's flags
+
+    int sX = 0, sY = 0;
+    int ox = 0, oy = 0, w = 0, h = 0; // the window, in world cells
+    int srcX = -1, srcY = -1, source = -1;
+    int passable_count = 0;
+    bool built = false;
+    std::vector<char> flags, parent_dir;
+    std::vector<int> dist, order;
+
+    void refresh();
+    bool passable(int c) const { return flags[c] & PASSABLE; }
+    void rebuild();
+    void grow_to(int x, int y);
+    bool in_window(int x, int y) const;
+    int neighbor(int c, DIRECTION dir) const;
+    int step_back(int c) const;
+    static void add_direction(int &x, int &y, DIRECTION dir);
+};
+
+#endif //_DISTANCE_FIELD_H
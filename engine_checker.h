@@ -0,0 +1,573 @@
+#ifndef _ENGINE_CHECKER_H
+#define _ENGINE_CHECKER_H
+
+#include <iostream>
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <set>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include "game.h"
+#include "constraint_transaction.h"
+#include "logic_engine.h"
+#include "frozen_engine.h"
+
+// One engine call, made with the same primitives RobotAgent::update_info uses.
+// A COMMIT step applies its batch of steps as one ConstraintTransaction, and a DENSITY step
+// gives its state a prior like the robot's pit density.
+class EngineStep {
+public:
+    enum KIND { ALL_OF, NONE_OF, ONE_OF, AT_LEAST_ONE_OF, ONE_OF_ALL, SET_KNOWN, COMMIT, DENSITY };
+
+    EngineStep(KIND kind_, std::set<std::pair<int, int>> keys_, CELL state_, double density_ = 0) :
+        kind(kind_), keys(std::move(keys_)), state(state_), density(density_) {}
+
+    KIND kind;
+    std::set<std::pair<int, int>> keys;
+    CELL state;
+    double density;
+    std::vector<EngineStep> batch;
+
+    // Applies the step and returns the error it raised, if any
+    template<class engine_type>
+    std::string try_apply(engine_type &engine) const {
+        try {
+            apply(engine);
+        } catch(const std::exception &e) {
+            return e.what();
+        }
+        return "";
+    }
+
+    // Like try_apply, but makes a COMMIT step's calls one at a time and stops at the first error.
+    // A transaction is rejected before it changes anything if it names a state the engine doesn't
+    // have, so the calls naming one go first.
+    template<class engine_type>
+    std::string try_apply_each(engine_type &engine, const std::set<CELL> &states) const {
+        if(kind != COMMIT) return try_apply(engine);
+        std::vector<EngineStep> calls = batch;
+        std::stable_partition(calls.begin(), calls.end(),
+                              [&states](const EngineStep &step) { return states.count(step.state) == 0; });
+        for(const EngineStep &step : calls) {
+            std::string error = step.try_apply(engine);
+            if(!error.empty()) return error;
+        }
+        return "";
+    }
+
+    template<class engine_type>
+    void apply(engine_type &engine) const {
+        if(kind == ALL_OF) engine.constrain_all_of(keys, state);
+        else if(kind == NONE_OF) engine.constrain_none_of(keys, state);
+        else if(kind == ONE_OF) engine.constrain_one_of(keys, state);
+        else if(kind == AT_LEAST_ONE_OF) engine.constrain_at_least_one_of(keys, state);
+        else if(kind == ONE_OF_ALL) engine.constrain_one_of(state);
+        else if(kind == SET_KNOWN) engine.set_known(*keys.begin(), state);
+        else if(kind == DENSITY) engine.set_density(state, density);
+        else if(kind == COMMIT) {
+            ConstraintTransaction<std::pair<int, int>, CELL> transaction;
+            for(const EngineStep &step : batch) {
+                if(step.kind == ALL_OF) transaction.constrain_all_of(step.keys, step.state);
+                else if(step.kind == NONE_OF) transaction.constrain_none_of(step.keys, step.state);
+                else if(step.kind == ONE_OF) transaction.constrain_one_of(step.keys, step.state);
+                else if(step.kind == AT_LEAST_ONE_OF) transaction.constrain_at_least_one_of(step.keys, step.state);
+                else if(step.kind == ONE_OF_ALL) transaction.constrain_one_of(step.state);
+            }
+            engine.commit(transaction);
+        }
+    }
+
+    std::string to_str() const {
+        static const char* kinds[] = {"all_of", "none_of", "one_of", "at_least_one_of", "one_of_all", "set_known",
+                                      "commit", "set_density"};
+        static const char* states[] = {"EMPTY", "PIT", "WUMPUS", "GOLD", "WALL"};
+        std::stringstream ss;
+        ss << kinds[kind] << "(";
+        if(kind == COMMIT) {
+            for(const EngineStep &step : batch) ss << step.to_str() << (&step == &batch.back() ? "" : ", ");
+            ss << ")";
+            return ss.str();
+        }
+        if(kind == DENSITY) {
+            ss << states[state] << ", " << density << ")";
+            return ss.str();
+        }
+        for(const auto &key : keys) ss << "(" << key.first << ", " << key.second << ")";
+        ss << ", " << states[state] << ")";
+        return ss.str();
+    }
+};
+
+// The frozen engine behind the calls the checker makes. The frozen engine checks a count only when
+// it is made, so every count it was given is made again after each call, and a transaction is made
+// one call at a time. It let a constraint that no key holds pass once every key was known, so that
+// is checked here. It has no densities or odds, so the checker leaves those out with it, and its
+// set_known merges a key away without the bounds, so the checker stops comparing with it there.
+class FrozenReference {
+public:
+    typedef std::pair<int, int> key_type;
+
+    explicit FrozenReference(const std::set<CELL> &states_) : engine(states_), states(states_) {}
+
+    bool find_by_state(CELL state, key_type &key) { return engine.find_by_state(state, key); }
+    bool is_true(const key_type &key, CELL state) { return engine.is_true(key, state); }
+    bool highest_prob(const std::vector<CELL> &of, key_type &key) { return engine.highest_prob(of, key); }
+    std::pair<std::set<CELL>, double> most_likely(const key_type &key) { return engine.most_likely(key); }
+
+    template<class Visit>
+    void for_each_odds(const std::vector<CELL> &, Visit) {}
+
+    void set_density(CELL, double) {
+        throw std::logic_error("The frozen engine has no densities!");
+    }
+
+    void set_known(const key_type &key, CELL state) {
+        engine.set_known(key, state);
+    }
+
+    void constrain_none_of(const std::set<key_type> &keys, CELL state) {
+        engine.constrain_none_of(keys, state);
+        named.insert(keys.begin(), keys.end());
+        recount();
+    }
+
+    void constrain_all_of(const std::set<key_type> &keys, CELL state) {
+        engine.constrain_all_of(keys, state);
+        named.insert(keys.begin(), keys.end());
+        recount();
+    }
+
+    void constrain_one_of(const std::set<key_type> &keys, CELL state) {
+        engine.constrain_one_of(keys, state);
+        named.insert(keys.begin(), keys.end());
+        check_held(keys, state);
+        recount();
+    }
+
+    void constrain_at_least_one_of(const std::set<key_type> &keys, CELL state) {
+        engine.constrain_at_least_one_of(keys, state);
+        named.insert(keys.begin(), keys.end());
+        check_held(keys, state);
+        recount();
+    }
+
+    void constrain_one_of(CELL state) {
+        engine.constrain_one_of(state);
+        counts.insert(state);
+        recount();
+    }
+
+    // A transaction is rejected before it changes anything if it names a state the engine doesn't
+    // have, so the calls naming one go first. The checker's only counts are exactly one.
+    void commit(const ConstraintTransaction<key_type, CELL> &transaction) {
+        typedef ConstraintTransaction<key_type, CELL> transaction_type;
+        for(bool known_states : {false, true}) {
+            for(const auto &c : transaction) {
+                if((states.count(c.state) > 0) != known_states) continue;
+                std::set<key_type> keys(c.keys.begin(), c.keys.end());
+                if(c.kind == transaction_type::ALL_OF) constrain_all_of(keys, c.state);
+                else if(c.kind == transaction_type::NONE_OF) constrain_none_of(keys, c.state);
+                else if(c.kind == transaction_type::ONE_OF) constrain_one_of(keys, c.state);
+                else if(c.kind == transaction_type::AT_LEAST_ONE_OF) constrain_at_least_one_of(keys, c.state);
+                else constrain_one_of(c.state);
+            }
+        }
+    }
+
+private:
+    FrozenEngine<key_type, CELL> engine;
+    std::set<CELL> states;
+    std::set<CELL> counts;
+    std::set<key_type> named;
+
+    void recount() {
+        for(CELL state : counts) {
+            engine.constrain_one_of(state);
+            check_held(named, state);
+        }
+    }
+
+    // Throws if every key is known and none of them is in the state
+    void check_held(const std::set<key_type> &keys, CELL state) {
+        for(const key_type &key : keys) {
+            if(engine.is_true(key, state)) return;
+            if(std::none_of(states.begin(), states.end(), [&](CELL s) { return engine.is_true(key, s); })) return;
+        }
+        throw std::runtime_error("You have provided conflicting information!");
+    }
+};
+
+// Runs a reference and a candidate LogicEngine side by side on random constraint sequences, and
+// the reference against the frozen engine. The sequences are the percepts of a random walk through
+// a random world. A quarter of them lie about one move, so the engines must agree on conflicts too.
+template<class Reference, class Candidate>
+class EngineChecker {
+public:
+    EngineChecker(unsigned seed, int sizeX_ = 5, int sizeY_ = 5) : rng(seed), sizeX(sizeX_), sizeY(sizeY_) {}
+
+    // Makes the engines compact their trees once they pass this many nodes instead of at their
+    // own thresholds, so that the small trees of the checked sequences get folded and reordered too
+    void force_compaction(size_t nodes = 8) {
+        compaction_threshold = nodes;
+    }
+
+    // Checks the regressions and then num_sequences random sequences, reporting the speedup of each one.
+    // Returns the number of sequences on which the engines disagreed.
+    int run(int num_sequences, std::ostream &out) {
+        int failures = check_regressions(out);
+        double reference_total = 0, candidate_total = 0;
+        for(int i = 0; i < num_sequences; ++i) {
+            std::vector<EngineStep> steps = generate();
+            std::string msg;
+            if(first_mismatch(steps, msg) >= 0) {
+                ++failures;
+                steps = shrink(steps);
+                first_mismatch(steps, msg);
+                out << "Sequence " << i << " MISMATCH: " << msg << std::endl;
+                out << "Minimal repro (" << steps.size() << " steps):" << std::endl;
+                for(const EngineStep &step : steps) out << "    " << step.to_str() << std::endl;
+                continue;
+            }
+
+            double reference_time = time<Reference>(steps);
+            double candidate_time = time<Candidate>(steps);
+            reference_total += reference_time;
+            candidate_total += candidate_time;
+            out << "Sequence " << i << ": " << steps.size() << " steps, speedup "
+                << reference_time / candidate_time << "x" << std::endl;
+        }
+        out << failures << " of " << num_sequences << " sequences mismatched";
+        if(candidate_total > 0) out << ", overall speedup " << reference_total / candidate_total << "x";
+        out << std::endl;
+        return failures;
+    }
+
+    // Replays every regression with the engines' own thresholds and with compaction forced,
+    // reporting each one the engines disagree on. Returns how many they disagreed on.
+    int check_regressions(std::ostream &out) {
+        int failures = 0;
+        size_t own_threshold = compaction_threshold;
+        for(size_t threshold : {own_threshold, (size_t)8}) {
+            compaction_threshold = threshold;
+            std::vector<std::vector<EngineStep>> cases = regressions();
+            for(int i = 0; i < (int)cases.size(); ++i) {
+                std::string msg;
+                if(first_mismatch(cases[i], msg) < 0) continue;
+                ++failures;
+                out << "Regression " << i << " MISMATCH: " << msg << std::endl;
+                for(const EngineStep &step : cases[i]) out << "    " << step.to_str() << std::endl;
+            }
+        }
+        compaction_threshold = own_threshold;
+        return failures;
+    }
+
+    std::vector<EngineStep> generate() {
+        std::vector<std::vector<CELL>> world(sizeX, std::vector<CELL>(sizeY, EMPTY));
+        std::vector<std::pair<int, int>> cells;
+        for(int x = 0; x < sizeX; ++x)
+            for(int y = 0; y < sizeY; ++y)
+                if(x + y > 1) cells.emplace_back(x, y);
+        std::shuffle(cells.begin(), cells.end(), rng);
+        world[cells[0].first][cells[0].second] = WUMPUS;
+        world[cells[1].first][cells[1].second] = GOLD;
+        for(int i = 2; i < (int)cells.size(); ++i)
+            if(std::uniform_real_distribution<>(0, 1)(rng) < 0.15)
+                world[cells[i].first][cells[i].second] = PIT;
+
+        std::vector<EngineStep> steps;
+        if(std::uniform_int_distribution<>(0, 1)(rng) == 0) // half the sequences weigh pits by a prior
+            steps.emplace_back(EngineStep::DENSITY, std::set<std::pair<int, int>>{}, PIT,
+                               std::uniform_real_distribution<>(0.05, 0.5)(rng));
+        int x = 0, y = 0;
+        int num_moves = sizeX * sizeY;
+        int lie = std::uniform_int_distribution<>(0, 3)(rng) == 0 ? std::uniform_int_distribution<>(0, num_moves - 1)(rng) : -1;
+        for(int move = 0; move < num_moves; ++move) {
+            std::vector<std::vector<CELL>> told;
+            if(move == lie) { // the percepts of a world with one neighboring room changed
+                told = world;
+                auto ns = neighbors(x, y);
+                auto n = ns[std::uniform_int_distribution<>(0, (int)ns.size() - 1)(rng)];
+                CELL &c = told[n.first][n.second];
+                c = (CELL)((c + std::uniform_int_distribution<>(1, 3)(rng)) % 4);
+            }
+            const std::vector<std::vector<CELL>> &percepts = move == lie ? told : world;
+
+            if(std::uniform_int_distribution<>(0, 1)(rng) == 0) add_percepts(percepts, x, y, steps);
+            else { // the same percepts as one transaction
+                steps.emplace_back(EngineStep::COMMIT, std::set<std::pair<int, int>>{}, EMPTY);
+                add_percepts(percepts, x, y, steps.back().batch);
+                if(std::uniform_int_distribution<>(0, 15)(rng) == 0) // names a state no key can take
+                    steps.back().batch.emplace_back(EngineStep::ONE_OF_ALL, std::set<std::pair<int, int>>{}, WALL);
+                std::shuffle(steps.back().batch.begin(), steps.back().batch.end(), rng); // counts before keys too
+            }
+
+            if(std::uniform_int_distribution<>(0, 7)(rng) == 0) {
+                auto cell = cells[std::uniform_int_distribution<>(0, (int)cells.size() - 1)(rng)];
+                steps.emplace_back(EngineStep::SET_KNOWN, std::set<std::pair<int, int>>{cell},
+                                   world[cell.first][cell.second]);
+            }
+
+            std::vector<std::pair<int, int>> moves;
+            for(const auto &n : neighbors(x, y))
+                if(world[n.first][n.second] == EMPTY) moves.push_back(n);
+            if(moves.empty()) break;
+            auto next = moves[std::uniform_int_distribution<>(0, (int)moves.size() - 1)(rng)];
+            x = next.first;
+            y = next.second;
+        }
+        return steps;
+    }
+
+    // Replays the steps on the frozen engine and the reference, on the reference and the candidate,
+    // and on each of those committing its transactions against making their calls one at a time.
+    // Returns the index of the first step after which two of them disagree, or -1.
+    int first_mismatch(const std::vector<EngineStep> &steps, std::string &msg) {
+        int i = -1;
+        if(std::none_of(steps.begin(), steps.end(), [](const EngineStep &step) { return step.kind == EngineStep::DENSITY; }))
+            i = first_difference<FrozenReference, Reference>(steps, FROZEN, "frozen engine", "reference", msg);
+        if(i < 0) i = first_difference<Reference, Candidate>(steps, SAME_CALLS, "reference", "candidate", msg);
+        if(i < 0) i = first_difference<Reference, Reference>(steps, EACH_CALL, "committing reference", "calling reference", msg);
+        if(i < 0) i = first_difference<Candidate, Candidate>(steps, EACH_CALL, "committing candidate", "calling candidate", msg);
+        return i;
+    }
+
+    // Removes chunks of steps, then single steps, for as long as the engines still disagree
+    std::vector<EngineStep> shrink(std::vector<EngineStep> steps) {
+        std::string msg;
+        int end = first_mismatch(steps, msg);
+        if(end < 0) return steps;
+        steps.erase(steps.begin() + end + 1, steps.end());
+
+        for(int chunk = (int)steps.size() / 2; chunk >= 1; chunk /= 2) {
+            int i = 0;
+            while(i < (int)steps.size()) {
+                std::vector<EngineStep> smaller(steps.begin(), steps.begin() + i);
+                if(i + chunk < (int)steps.size())
+                    smaller.insert(smaller.end(), steps.begin() + i + chunk, steps.end());
+                int smaller_end = first_mismatch(smaller, msg);
+                if(smaller_end >= 0) {
+                    smaller.erase(smaller.begin() + smaller_end + 1, smaller.end());
+                    steps = smaller;
+                } else i += chunk;
+            }
+        }
+        return steps;
+    }
+
+    // Seconds one engine takes to apply the steps and make the same queries after each, without
+    // formatting the answers. The fastest of a few runs is kept so that one slow run doesn't count.
+    template<class engine_type>
+    double time(const std::vector<EngineStep> &steps) {
+        double best = 0;
+        for(int run = 0; run < TIMED_RUNS; ++run) {
+            auto begin = std::chrono::steady_clock::now();
+            engine_type engine(states());
+            compact_early(engine);
+            for(const EngineStep &step : steps) {
+                if(!step.try_apply(engine).empty()) break;
+                sink += query(engine);
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            if(run == 0 || seconds < best) best = seconds;
+        }
+        return best;
+    }
+
+private:
+    static constexpr int TIMED_RUNS = 5;
+
+    std::mt19937 rng;
+    int sizeX, sizeY;
+    double sink = 0; // what the timed queries answered, so they can't be optimized away
+    size_t compaction_threshold = 0; // zero leaves the engines' own thresholds
+
+    // How first_difference replays the steps on its two engines
+    enum COMPARISON {
+        SAME_CALLS, // the same calls, comparing every answer, after an error too
+        EACH_CALL,  // the second engine makes each transaction's calls one at a time, up to the first error
+        FROZEN      // the first engine is the frozen one, leaving out odds, up to the first error or key set known
+    };
+
+    // Replays the steps on engines a and b, comparing every query after each step
+    template<class A, class B>
+    int first_difference(const std::vector<EngineStep> &steps, COMPARISON comparison, const std::string &name_a,
+                         const std::string &name_b, std::string &msg) {
+        A a(states());
+        B b(states());
+        compact_early(a);
+        compact_early(b);
+        for(int i = 0; i < (int)steps.size(); ++i) {
+            if(comparison == FROZEN && steps[i].kind == EngineStep::SET_KNOWN) return -1;
+            std::string error_a = steps[i].try_apply(a);
+            std::string error_b = comparison == EACH_CALL ? steps[i].try_apply_each(b, states()) : steps[i].try_apply(b);
+            if(error_a != error_b) {
+                msg = "after step " + std::to_string(i) + " " + steps[i].to_str() + ": " + name_a + " failed with \""
+                      + error_a + "\" but " + name_b + " failed with \"" + error_b + "\"";
+                return i;
+            }
+            // Calls made before a failing one may have deduced more than the failed transaction,
+            // and the frozen engine's tree is left as it was when it found the conflict
+            if(comparison != SAME_CALLS && !error_a.empty()) return -1;
+            if(!same_answers(a, b, comparison != FROZEN, name_a, name_b, msg)) {
+                msg = "after step " + std::to_string(i) + " " + steps[i].to_str() + ": " + msg;
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    static std::set<CELL> states() { return {EMPTY, PIT, WUMPUS, GOLD}; }
+
+    // Sequences that once broke an engine
+    static std::vector<std::vector<EngineStep>> regressions() {
+        using cells = std::set<std::pair<int, int>>;
+        auto commit = [](std::vector<EngineStep> batch) {
+            EngineStep step(EngineStep::COMMIT, cells{}, EMPTY);
+            step.batch = std::move(batch);
+            return step;
+        };
+        return {
+            { // a known key takes the last pit the bound allows while the tree still needs one
+                {EngineStep::ALL_OF, cells{{3, 0}}, PIT},
+                {EngineStep::ONE_OF_ALL, cells{}, PIT},
+                {EngineStep::SET_KNOWN, cells{{2, 3}}, PIT},
+                {EngineStep::NONE_OF, cells{{1, 2}}, EMPTY},
+            },
+            { // the queries after a contradiction still weighed the keys folded out of the released tree
+                {EngineStep::NONE_OF, cells{{2, 2}}, WUMPUS},
+                {EngineStep::AT_LEAST_ONE_OF, cells{{1, 0}, {0, 1}}, PIT},
+                {EngineStep::ONE_OF, cells{{1, 1}, {2, 0}, {0, 2}}, GOLD},
+                {EngineStep::ALL_OF, cells{{1, 0}, {0, 1}}, EMPTY},
+            },
+            { // a transaction checked a count's minimum against keys it named after the count
+                commit({{EngineStep::AT_LEAST_ONE_OF, cells{{1, 3}, {3, 2}}, PIT},
+                        {EngineStep::NONE_OF, cells{{0, 2}, {1, 3}, {3, 3}}, GOLD},
+                        {EngineStep::ONE_OF_ALL, cells{}, EMPTY},
+                        {EngineStep::NONE_OF, cells{{2, 2}, {2, 3}}, WUMPUS},
+                        {EngineStep::AT_LEAST_ONE_OF, cells{{0, 2}}, PIT}}),
+            },
+            { // and let a count at its start wait for the keys named after it
+                commit({{EngineStep::ONE_OF_ALL, cells{}, PIT},
+                        {EngineStep::NONE_OF, cells{{0, 3}, {1, 2}}, PIT},
+                        {EngineStep::AT_LEAST_ONE_OF, cells{{0, 2}, {1, 0}, {2, 0}}, PIT}}),
+            },
+        };
+    }
+    static inline const std::vector<std::vector<CELL>> query_groups = {{GOLD, EMPTY}, {PIT}, {WUMPUS}};
+    static inline const std::vector<CELL> odds_states = {PIT, WUMPUS, GOLD};
+
+    // Only LogicEngine compacts its tree, so other engines are left as they are
+    template<class engine_type>
+    void compact_early(engine_type &) const {}
+
+    template<class key_type, class state_type>
+    void compact_early(LogicEngine<key_type, state_type> &engine) const {
+        if(compaction_threshold == 0) return;
+        engine.set_fold_threshold(compaction_threshold);
+        engine.set_reorder_threshold(compaction_threshold);
+    }
+
+    std::vector<std::pair<int, int>> neighbors(int x, int y) const {
+        std::vector<std::pair<int, int>> result;
+        if(y + 1 < sizeY) result.emplace_back(x, y + 1);
+        if(y > 0) result.emplace_back(x, y - 1);
+        if(x + 1 < sizeX) result.emplace_back(x + 1, y);
+        if(x > 0) result.emplace_back(x - 1, y);
+        return result;
+    }
+
+    void add_percepts(const std::vector<std::vector<CELL>> &world, int x, int y, std::vector<EngineStep> &steps) {
+        std::set<std::pair<int, int>> locs;
+        for(const auto &n : neighbors(x, y)) locs.insert(n);
+        auto senses = [&](CELL c) {
+            for(const auto &n : locs)
+                if(world[n.first][n.second] == c) return true;
+            return false;
+        };
+
+        steps.emplace_back(EngineStep::ALL_OF, std::set<std::pair<int, int>>{{x, y}}, EMPTY);
+        for(CELL c : {WUMPUS, GOLD}) {
+            if(senses(c)) {
+                steps.emplace_back(EngineStep::ONE_OF, locs, c);
+                steps.emplace_back(EngineStep::ONE_OF_ALL, std::set<std::pair<int, int>>{}, c);
+            } else steps.emplace_back(EngineStep::NONE_OF, locs, c);
+        }
+        if(senses(PIT)) steps.emplace_back(EngineStep::AT_LEAST_ONE_OF, locs, PIT);
+        else steps.emplace_back(EngineStep::NONE_OF, locs, PIT);
+    }
+
+    // Makes every query answers() does and folds the answers into a number
+    template<class engine_type>
+    double query(engine_type &engine) {
+        double total = 0;
+        std::pair<int, int> key;
+        for(CELL c : states())
+            if(engine.find_by_state(c, key)) total += key.first + key.second;
+        for(const std::vector<CELL> &group : query_groups)
+            if(engine.highest_prob(group, key)) total += key.first + key.second;
+        engine.for_each_odds(odds_states, [&total](const std::pair<int, int> &, int, double odds) { total += odds; });
+        for(int x = 0; x < sizeX; ++x) {
+            for(int y = 0; y < sizeY; ++y) {
+                for(CELL c : states())
+                    if(engine.is_true({x, y}, c)) ++total;
+                total += engine.most_likely({x, y}).second;
+            }
+        }
+        return total;
+    }
+
+    // Writes every query answer the engine gives into str
+    template<class engine_type>
+    void answers(engine_type &engine, bool odds, std::string &str) {
+        std::stringstream ss;
+        for(CELL c : states()) {
+            std::pair<int, int> key;
+            if(engine.find_by_state(c, key)) ss << "find_by_state " << c << " (" << key.first << ", " << key.second << ")\n";
+        }
+        for(const std::vector<CELL> &group : query_groups) {
+            std::pair<int, int> key;
+            if(engine.highest_prob(group, key)) ss << "highest_prob " << group[0] << " (" << key.first << ", " << key.second << ")\n";
+        }
+        if(odds) engine.for_each_odds(odds_states, [&](const std::pair<int, int> &key, int i, double odds) {
+            ss << "odds (" << key.first << ", " << key.second << ") " << odds_states[i] << " "
+                << std::round(odds * 1e9) / 1e9 << "\n";
+        });
+        for(int x = 0; x < sizeX; ++x) {
+            for(int y = 0; y < sizeY; ++y) {
+                for(CELL c : states())
+                    if(engine.is_true({x, y}, c)) ss << "is_true (" << x << ", " << y << ") " << c << "\n";
+                auto likely = engine.most_likely({x, y});
+                ss << "most_likely (" << x << ", " << y << ")";
+                for(CELL c : likely.first) ss << " " << c;
+                ss << " " << std::round(likely.second * 1e9) / 1e9 << "\n";
+            }
+        }
+        str = ss.str();
+    }
+
+    template<class A, class B>
+    bool same_answers(A &engine_a, B &engine_b, bool odds, const std::string &name_a, const std::string &name_b,
+                      std::string &msg) {
+        std::string a, b;
+        answers(engine_a, odds, a);
+        answers(engine_b, odds, b);
+        if(a == b) return true;
+
+        std::stringstream sa(a), sb(b);
+        std::string la, lb;
+        while(true) {
+            bool more_a = (bool)std::getline(sa, la), more_b = (bool)std::getline(sb, lb);
+            if(!more_a) la = "(nothing)";
+            if(!more_b) lb = "(nothing)";
+            if(la != lb) break;
+        }
+        msg = name_a + " answered \"" + la + "\" but " + name_b + " answered \"" + lb + "\"";
+        return false;
+    }
+};
+
+#endif //_ENGINE_CHECKER_H
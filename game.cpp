@@ -1,52 +1,57 @@
-#include <fstream>
+#include <algorithm>
+#include <sstream>
 #include <iostream>
 #include <cassert>
 #include <iomanip>
 #include "game.h"
 
-void Game::run_game(const std::string &fileName) {
-    std::ifstream stream(fileName);
-    if(!stream.good()) {
-        std::cerr << "Can't open " << fileName << " to read." << std::endl;
-        exit(1);
+GameResult Game::run_game(const std::string &fileName) {
+    result = GameResult();
+    int sizeX, sizeY;
+    unsigned seed;
+    double pit_density;
+    if(parse_random(fileName, sizeX, sizeY, seed, pit_density)) {
+        world.generate(sizeX, sizeY, seed, pit_density);
+    } else if(fileName.compare(0, 7, "random:") == 0) {
+        result.error = fileName + " should be random:<width>x<height>:<seed>[:<pit density>].";
+        return result;
+    } else if(!world.load(fileName, result.error)) {
+        return result;
     }
 
-    std::string s;
-    while(stream >> s) {
-        grid.emplace_back();
-        for(char c: s) grid[grid.size() - 1].emplace_back(to_cell(c));
+    // An agent that fails, or whose engine is given conflicting information, ends only its own game
+    try {
+        play();
+    } catch(const std::exception &e) {
+        result.error = e.what();
     }
-
-    assert(sizeY() > 0);
-    assert(sizeX() > 0);
-
-    run_game();
+    return result;
 }
 
-void Game::run_game() {
+void Game::begin_game() {
     wX = wY = 0;
     found_gold = used_bullet = false;
-    int move_num = 1;
-    std::string msg;
-    Sense sense;
     start(sizeX(), sizeY());
+}
 
-    while(true) {
-        print_grid();
-        if(!msg.empty()) std::cout << "MESSAGE: " << msg << std::endl;
-        update_senses(sense);
-        print_senses(sense);
-        std::cin.ignore();
-        Move move = choose_move(sense);
-        print_move(move, move_num);
-        sense = Sense();
-        if(!do_move(move, sense, msg)) break;
-        ++move_num;
-    }
-
+void Game::end_game(const std::string &msg) {
+    result.msg = msg;
+    if(quiet) return;
     hide_world_info = false;
     print_grid();
     if(!msg.empty()) std::cout << "MESSAGE: " << msg << std::endl;
+    std::cout << "MOVE LATENCY: ";
+    result.latency.print(std::cout);
+    std::cout << std::endl;
+}
+
+Move Game::replace_late_move(const Move &late) {
+    for(DIRECTION dir : {DIRECTION::UP, DIRECTION::RIGHT, DIRECTION::DOWN, DIRECTION::LEFT}) {
+        int x = wX, y = wY;
+        add_direction(x, y, dir);
+        if(x >= 0 && y >= 0 && x < sizeX() && y < sizeY()) return walk(dir);
+    }
+    return walk(late.dir); // a one room world has nowhere else to go
 }
 
 bool Game::do_move(const Move &move, Sense &sense, std::string &msg) {
@@ -78,6 +83,7 @@ bool Game::do_move(const Move &move, Sense &sense, std::string &msg) {
 
         if(found_gold && wX == 0 && wY == 0) {
             msg = "You won!!";
+            result.won = true;
             return false;
         }
 
@@ -104,17 +110,6 @@ void Game::update_senses(Sense &sense) {
     sense.breeze = find(PIT);
 }
 
-CELL Game::get(int x, int y) const {
-    if(x < 0 || y < 0 || x >= sizeX() || y >= sizeY())
-        return WALL;
-    return grid[sizeY() - 1 - y][x];
-}
-
-void Game::set(int x, int y, CELL c) {
-    assert(!(x < 0 || y < 0 || x >= sizeX() || y >= sizeY()));
-    grid[sizeY() - 1 - y][x] = c;
-}
-
 bool Game::find(CELL c) const {
     if(get(wX + 1, wY) == c) return true;
     if(get(wX - 1, wY) == c) return true;
@@ -151,20 +146,29 @@ void Game::print_move(const Move &move, int move_num) {
     std::cout << std::endl;
 }
 
+// Prints the rooms within PRINT_WINDOW of the robot, so a huge generated world only creates the
+// tiles around it
 void Game::print_grid() {
     int width = 7;
+    int x0 = std::max(0, std::min(wX - PRINT_WINDOW / 2, sizeX() - PRINT_WINDOW));
+    int y0 = std::max(0, std::min(wY - PRINT_WINDOW / 2, sizeY() - PRINT_WINDOW));
+    int x1 = std::min(sizeX(), x0 + PRINT_WINDOW), y1 = std::min(sizeY(), y0 + PRINT_WINDOW);
+    if(x1 - x0 < sizeX() || y1 - y0 < sizeY())
+        std::cout << "Rooms " << x0 << " to " << x1 - 1 << " across and " << y0 << " to " << y1 - 1
+                  << " up of " << sizeX() << "x" << sizeY() << std::endl;
+
     std::string hbar, str;
-    for(int i = 0; i < (sizeX() * (width + 1) + 1); ++i) hbar += "_";
+    for(int i = 0; i < ((x1 - x0) * (width + 1) + 1); ++i) hbar += "_";
 
-    for(int y = sizeY() - 1; y >= 0; --y) {
+    for(int y = y1 - 1; y >= y0; --y) {
         std::cout << hbar << std::endl << "|";
-        for(int x = 0; x < sizeX(); ++x){
+        for(int x = x0; x < x1; ++x){
             if(!hide_world_info) str = to_str(get(x, y));
             else str = "";
             std::cout << std::setw(width) << str << "|";
         }
         std::cout << std::endl << "|";
-        for(int x = 0; x < sizeX(); ++x) {
+        for(int x = x0; x < x1; ++x) {
             if(wX == x && wY == y) str = "Robot";
             else str = "";
             std::cout << std::setw(width) << str << "|";
@@ -200,11 +204,14 @@ std::string Game::to_str(CELL c) {
     return {};
 }
 
-CELL Game::to_cell(char c) {
-    if(c == 'E') return CELL::EMPTY;
-    else if(c == 'P') return CELL::PIT;
-    else if(c == 'W') return CELL::WUMPUS;
-    else if(c == 'G') return CELL::GOLD;
-    assert(false);
-    return {};
-}
\ No newline at end of file
+bool Game::parse_random(const std::string &spec, int &sizeX, int &sizeY, unsigned &seed, double &pit_density) {
+    pit_density = 0.1;
+    char x, colon;
+    std::istringstream stream(spec);
+    std::string prefix;
+    if(!std::getline(stream, prefix, ':') || prefix != "random") return false;
+    if(!(stream >> sizeX >> x >> sizeY >> colon >> seed) || x != 'x' || colon != ':') return false;
+    if(stream >> colon && (colon != ':' || !(stream >> pit_density))) return false;
+    stream >> std::ws;
+    return stream.eof() && sizeX > 0 && sizeY > 0 && pit_density >= 0 && pit_density < 1;
+}
@@ -3,10 +3,15 @@
 
 #include <vector>
 #include <string>
+#include <chrono>
+#include <iostream>
+#include "latency.h"
+#include "world.h"
 
-// Enums to represent a direction and the contents of a square in the world
+// Enums to represent a direction
 enum DIRECTION { UP, RIGHT, DOWN, LEFT };
-enum CELL { EMPTY, PIT, WUMPUS, GOLD, WALL };
+// What happens when choose_move takes longer than the deadline
+enum OVERRUN { LOG_ONLY, FORFEIT, DEFAULT_MOVE };
 
 // Represents a move by the agent
 class Move {
@@ -22,46 +27,139 @@ public:
     bool glitter, breeze, stench, just_found_gold, just_killed_wumpus;
 };
 
+// The outcome of one game
+class GameResult {
+public:
+    GameResult() : won(false), moves(0) {}
+    bool won;
+    int moves;
+    std::string msg;
+    std::string error; // why the game couldn't be played to the end, if it failed
+    LatencyHistogram latency; // time spent in each choose_move call
+};
+
 class Game {
 public:
-    // Loads in a game file and runs the game
-    void run_game(const std::string &fileName);
+    virtual ~Game() = default;
+
+    // Loads in a game file and runs the game. A name of the form random:<width>x<height>:<seed>
+    // with an optional :<pit density> plays a generated world instead.
+    GameResult run_game(const std::string &fileName);
+
+    // Skips printing the world and waiting for ENTER between moves, for batch runs
+    void set_quiet(bool quiet_) { quiet = quiet_; }
+    // Checks each choose_move call against limit. The call can't be interrupted, so an overrun is
+    // handled once it returns: logged, the game forfeited, or the move replaced by replace_late_move.
+    void set_deadline(std::chrono::nanoseconds limit, OVERRUN action) {
+        deadline = limit;
+        overrun = action;
+    }
 
 protected:
-    Game(bool hide_world_info_ = false) : hide_world_info(hide_world_info_) {}
+    Game(bool hide_world_info_ = false) : hide_world_info(hide_world_info_), quiet(false),
+        deadline(std::chrono::nanoseconds::zero()), overrun(LOG_ONLY) {}
 
     // Override this function to initialize values at the beginning of the game
     virtual void start(int sizeX, int sizeY) {}
     // Override this function to choose your move
     virtual Move choose_move(const Sense &sense) { return walk(DIRECTION::DOWN); };
+    // Override this function to pick the move played when choose_move returned late under the
+    // DEFAULT_MOVE overrun action. An agent that already acted on late must take it back here.
+    // By default it walks to the first neighboring room inside the world.
+    virtual Move replace_late_move(const Move &late);
 
     // Use these functions to make your move
     static Move walk(DIRECTION dir) { return {false, dir}; }
     static Move shoot(DIRECTION dir) { return {true, dir}; }
 
+    // Plays one game, asking choose_move through the virtual table. StaticGame overrides this
+    // so that the agent's choose_move is called directly.
+    virtual void play() { play_moves([this](const Sense &sense) { return choose_move(sense); }); }
+    template<class Chooser>
+    void play_moves(const Chooser &choose);
+
 private:
-    std::vector<std::vector<CELL>> grid;
+    World world;
     int wX, wY;
-    bool used_bullet, found_gold, hide_world_info;
+    bool used_bullet, found_gold, hide_world_info, quiet;
+    std::chrono::nanoseconds deadline;
+    OVERRUN overrun;
+    GameResult result;
 
-    void run_game();
+    void begin_game();
+    void end_game(const std::string &msg);
     bool do_move(const Move &move, Sense &sense, std::string &msg);
     void update_senses(Sense &sense);
 
-    CELL get(int x, int y) const;
-    void set(int x, int y, CELL c);
+    CELL get(int x, int y) const { return world.get(x, y); }
+    void set(int x, int y, CELL c) { world.set(x, y, c); }
     bool find(CELL c) const;
-    int sizeX() const { return (int)grid[0].size(); };
-    int sizeY() const { return (int)grid.size(); };
+    int sizeX() const { return world.sizeX(); };
+    int sizeY() const { return world.sizeY(); };
 
+    static constexpr int PRINT_WINDOW = 16; // rooms across and up printed around the robot
     static void print_senses(const Sense &sense);
     static void print_move(const Move &move, int move_num);
     void print_grid();
 
     static void add_direction(int &x, int &y, DIRECTION dir);
-    static CELL to_cell(char c);
+    static bool parse_random(const std::string &spec, int &sizeX, int &sizeY, unsigned &seed, double &pit_density);
     static std::string to_str(CELL c);
     static std::string to_str(DIRECTION d);
 };
 
+template<class Chooser>
+void Game::play_moves(const Chooser &choose) {
+    begin_game();
+    int move_num = 1;
+    std::string msg;
+    Sense sense;
+
+    while(true) {
+        if(!quiet) {
+            print_grid();
+            if(!msg.empty()) std::cout << "MESSAGE: " << msg << std::endl;
+        }
+        update_senses(sense);
+        if(!quiet) {
+            print_senses(sense);
+            std::cin.ignore();
+        }
+
+        auto begin = std::chrono::steady_clock::now();
+        Move move = choose(sense);
+        auto elapsed = std::chrono::steady_clock::now() - begin;
+        result.latency.record(elapsed);
+        if(deadline > std::chrono::nanoseconds::zero() && elapsed > deadline) {
+            if(overrun == FORFEIT) {
+                msg = "You ran out of time!";
+                break;
+            }
+            if(overrun == DEFAULT_MOVE) move = replace_late_move(move);
+            else std::cerr << "Move " << move_num << " overran its deadline" << std::endl;
+        }
+
+        if(!quiet) print_move(move, move_num);
+        ++result.moves;
+        sense = Sense();
+        if(!do_move(move, sense, msg)) break;
+        ++move_num;
+    }
+
+    end_game(msg);
+}
+
+// A Game whose agent type is known at compile time. The agent derives from StaticGame<Agent> and
+// befriends it, and the game loop then calls Agent::choose_move directly so it can be inlined.
+template<class Agent>
+class StaticGame : public Game {
+protected:
+    using Game::Game;
+
+    void play() override {
+        Agent &agent = static_cast<Agent&>(*this);
+        play_moves([&agent](const Sense &sense) { return agent.Agent::choose_move(sense); });
+    }
+};
+
 #endif //_GAME_H
@@ -0,0 +1,64 @@
+#include <algorithm>
+#include <iomanip>
+#include "latency.h"
+
+void LatencyHistogram::record(std::chrono::nanoseconds duration) {
+    long long ns = std::max<long long>(duration.count(), 0);
+    int b = bucket_of(ns);
+    if(b >= (int)buckets.size()) buckets.resize(b + 1, 0);
+    ++buckets[b];
+    ++total;
+    max_ns = std::max(max_ns, ns);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other) {
+    if(other.buckets.size() > buckets.size()) buckets.resize(other.buckets.size(), 0);
+    for(int b = 0; b < (int)other.buckets.size(); ++b) buckets[b] += other.buckets[b];
+    total += other.total;
+    max_ns = std::max(max_ns, other.max_ns);
+}
+
+std::chrono::nanoseconds LatencyHistogram::percentile(double fraction) const {
+    long long rank = (long long)(fraction * total + 0.5);
+    long long seen = 0;
+    for(int b = 0; b < (int)buckets.size(); ++b) {
+        seen += buckets[b];
+        if(seen >= rank && seen > 0) return std::chrono::nanoseconds(std::min(bucket_limit(b), max_ns));
+    }
+    return max();
+}
+
+void LatencyHistogram::print(std::ostream &out) const {
+    out << "p50 ";
+    print_duration(out, percentile(0.5));
+    out << ", p99 ";
+    print_duration(out, percentile(0.99));
+    out << ", max ";
+    print_duration(out, max());
+    out << " over " << total << " moves";
+}
+
+int LatencyHistogram::bucket_of(long long ns) {
+    if(ns < SUB_BUCKETS) return (int)ns;
+    int exponent = 63 - __builtin_clzll((unsigned long long)ns); // ns >= 2^exponent
+    int step = (int)((ns >> (exponent - 3)) & (SUB_BUCKETS - 1));
+    return (exponent - 2) * SUB_BUCKETS + step;
+}
+
+long long LatencyHistogram::bucket_limit(int bucket) {
+    if(bucket < SUB_BUCKETS) return bucket;
+    int exponent = bucket / SUB_BUCKETS + 2;
+    int step = bucket % SUB_BUCKETS;
+    return ((long long)(SUB_BUCKETS + step + 1) << (exponent - 3)) - 1;
+}
+
+void LatencyHistogram::print_duration(std::ostream &out, std::chrono::nanoseconds duration) {
+    double ns = (double)duration.count();
+    std::ios::fmtflags flags = out.flags();
+    out << std::fixed << std::setprecision(1);
+    if(ns < 1e3) out << ns << "ns";
+    else if(ns < 1e6) out << ns / 1e3 << "us";
+    else if(ns < 1e9) out << ns / 1e6 << "ms";
+    else out << ns / 1e9 << "s";
+    out.flags(flags);
+}
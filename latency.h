@@ -0,0 +1,34 @@
+#ifndef _LATENCY_H
+#define _LATENCY_H
+
+#include <vector>
+#include <chrono>
+#include <ostream>
+
+// Counts durations in log-spaced buckets, each a power of two split into eight steps,
+// so percentiles are within about 12% at any scale and histograms merge by adding buckets
+class LatencyHistogram {
+public:
+    void record(std::chrono::nanoseconds duration);
+    void merge(const LatencyHistogram &other);
+
+    long long count() const { return total; }
+    std::chrono::nanoseconds max() const { return std::chrono::nanoseconds(max_ns); }
+    // Upper bound of the bucket holding the given fraction of the durations, capped at max
+    std::chrono::nanoseconds percentile(double fraction) const;
+
+    // Prints "p50 ..., p99 ..., max ... over N moves"
+    void print(std::ostream &out) const;
+
+private:
+    static const int SUB_BUCKETS = 8;
+
+    std::vector<long long> buckets;
+    long long total = 0, max_ns = 0;
+
+    static int bucket_of(long long ns);
+    static long long bucket_limit(int bucket);
+    static void print_duration(std::ostream &out, std::chrono::nanoseconds duration);
+};
+
+#endif //_LATENCY_H
@@ -1,24 +1,43 @@
 #ifndef _LOGIC_ENGINE_H
 #define _LOGIC_ENGINE_H
 
+#include <iostream>
 #include <utility>
+#include <algorithm>
 #include <vector>
+#include <array>
 #include <set>
 #include <map>
+#include <string>
+#include <stdexcept>
+#include <cmath>
+#include <climits>
 #include <cassert>
+#include "constraint_transaction.h"
+#include "alloc_check.h"
+
+// Thrown when constraints contradict each other or name a state that isn't possible
+class LogicError : public std::runtime_error {
+public:
+    explicit LogicError(const std::string &msg) : std::runtime_error(msg) {}
+};
 
 template<class key_type, class state_type>
 class Node {
 public:
-    Node() : children({}), parent(nullptr), next(nullptr), last(nullptr), key(), value(), num_leaves(1) {}
+    static constexpr int MAX_TRACKED = 4; // states with a count bound or density at once
+    Node() : children({}), parent(nullptr), next(nullptr), last(nullptr), key(), value(), num_leaves(1),
+        weight(1) {}
     Node(const key_type &k, const state_type &v) : children({}), parent(nullptr), next(nullptr),
-        last(nullptr), key(k), value(v), num_leaves(1) {}
+        last(nullptr), key(k), value(v), num_leaves(1), weight(1) {}
 
     std::set<Node*> children;
     Node *parent, *next, *last;
     key_type key;
     state_type value;
     int num_leaves;
+    double weight; // sum of the prior weights of the leaves below
+    std::array<int, MAX_TRACKED> tally{}; // times each tracked state appears on the path from the root
 };
 
 template<class key_type, class state_type>
@@ -26,15 +45,38 @@ class LogicEngine {
 public:
     typedef Node<key_type, state_type> node;
 
-    LogicEngine() = default;
+    LogicEngine() : root(nullptr), last_level(nullptr), name_clock(0),
+        fold_threshold(DEFAULT_FOLD_THRESHOLD), reorder_threshold(DEFAULT_REORDER_THRESHOLD) {}
 
-    LogicEngine(const std::set<state_type> &possible_states_) : possible_states(possible_states_) {
+    LogicEngine(const std::set<state_type> &possible_states_) : possible_states(possible_states_), name_clock(0),
+        fold_threshold(DEFAULT_FOLD_THRESHOLD), reorder_threshold(DEFAULT_REORDER_THRESHOLD) {
+        odds_sums.reserve(possible_states.size()); // so for_each_odds never allocates
         root = new node();
         last_level = new node();
         last_level->next = root;
         root->last = last_level;
     }
 
+    LogicEngine(const LogicEngine &) = delete;
+    LogicEngine &operator=(const LogicEngine &) = delete;
+
+    LogicEngine(LogicEngine &&other) noexcept : root(nullptr), last_level(nullptr), name_clock(0),
+        fold_threshold(DEFAULT_FOLD_THRESHOLD), reorder_threshold(DEFAULT_REORDER_THRESHOLD) {
+        swap(other);
+    }
+
+    LogicEngine &operator=(LogicEngine &&other) noexcept {
+        if(this != &other) {
+            release();
+            swap(other);
+        }
+        return *this;
+    }
+
+    ~LogicEngine() {
+        release();
+    }
+
     bool find_by_state(const state_type &state, key_type &key) {
         for(const auto &pair : known) {
             if(pair.second == state) {
@@ -52,51 +94,142 @@ public:
     }
 
     bool highest_prob(const std::vector<state_type> &states, key_type &key) {
-        if(configs.empty()) return false;
-        int highestCount = 0;
-        for(const auto &level : configs) { // loop over keys
-            node* n = level.second->next;
-            int count = 0;
-            while(n) {
-                for(const state_type &state : states) {
-                    if(state == n->value) {
-                        count += n->num_leaves;
-                        break;
+        if(!root || (configs.empty() && folded.empty())) return false;
+        double highestCount = 0;
+        auto level = configs.begin();
+        auto fold = folded.begin();
+        while(level != configs.end() || fold != folded.end()) { // loop over keys in order
+            double count = 0;
+            const key_type *k;
+            if(fold == folded.end() || (level != configs.end() && level->first < fold->first)) {
+                k = &level->first;
+                node* n = level->second->next;
+                while(n) {
+                    for(const state_type &state : states) {
+                        if(state == n->value) {
+                            count += n->weight;
+                            break;
+                        }
                     }
+                    n = n->next;
                 }
-                n = n->next;
+                ++level;
+            } else {
+                k = &fold->first;
+                double selected = 0, total = 0;
+                for(const state_type &value : fold->second) {
+                    total += value_odds(value);
+                    if(std::find(states.begin(), states.end(), value) != states.end()) selected += value_odds(value);
+                }
+                count = root->weight * selected / total;
+                ++fold;
             }
-            if(count > highestCount) {
+            if(count > highestCount * (1 + 1e-12)) { // within rounding is a tie, which the first key wins
                 highestCount = count;
-                key = level.first;
+                key = *k;
             }
         }
         return highestCount > 0;
     }
 
+    // Calls visit(key, i, odds) with the chance that each key not yet known is in states[i],
+    // sweeping the whole tree once so callers can weigh many cells against the same counts
+    template<class Visit>
+    void for_each_odds(const std::vector<state_type> &states, Visit visit) {
+        if(!root) return;
+        auto level = configs.begin();
+        auto fold = folded.begin();
+        while(level != configs.end() || fold != folded.end()) { // loop over keys in order
+            if(fold == folded.end() || (level != configs.end() && level->first < fold->first)) {
+                odds_sums.assign(states.size(), 0);
+                for(node* n = level->second->next; n; n = n->next) {
+                    auto itr = std::find(states.begin(), states.end(), n->value);
+                    if(itr != states.end()) odds_sums[itr - states.begin()] += n->weight;
+                }
+                for(int i = 0; i < (int)states.size(); ++i) visit(level->first, i, odds_sums[i] / root->weight);
+                ++level;
+            } else {
+                double total = 0;
+                for(const state_type &value : fold->second) total += value_odds(value);
+                for(int i = 0; i < (int)states.size(); ++i) {
+                    bool allowed = fold->second.find(states[i]) != fold->second.end();
+                    visit(fold->first, i, allowed ? value_odds(states[i]) / total : 0);
+                }
+                ++fold;
+            }
+        }
+    }
+
+    // Every key in the order it was set known, so callers can catch up on what changed
+    const std::vector<key_type> &known_order() const {
+        return known_log;
+    }
+
     void set_known(const key_type &key, const state_type &state) {
+        check_usable();
         if(possible_states.find(state) == possible_states.end()) illegal_state();
+        auto known_itr = known.find(key);
+        if(known_itr != known.end()) {
+            int i = tracked_index(known_itr->second);
+            if(i >= 0) --known_tally[i];
+        }
+        int i = tracked_index(state);
+        if(i >= 0) ++known_tally[i];
+        if(i >= 0 && known_tally[i] > tracked[i].max) illegal_constraint();
+        AllocationCheck::Exempt growth; // the level's subtrees merge into their parents' children
         remove_list(key);
+        folded.erase(key);
         known[key] = state;
+        known_log.push_back(key);
     }
 
     std::pair<std::set<state_type>, double> most_likely(const key_type &key) {
         auto known_itr = known.find(key);
         if(known_itr != known.end()) return {{known_itr->second}, 1};
+        if(!root) return {possible_states, 1.0 / possible_states.size()}; // released, as for a key never named
+
+        std::vector<double> counts;
+        auto fold_itr = folded.find(key);
+        if(fold_itr != folded.end()) {
+            double total = 0;
+            for(const state_type &value : fold_itr->second) total += value_odds(value);
+            for(const state_type &state : possible_states) {
+                bool allowed = fold_itr->second.find(state) != fold_itr->second.end();
+                counts.push_back(allowed ? root->weight * value_odds(state) / total : 0);
+            }
+            return most_likely_of(counts);
+        }
 
         auto configs_itr = configs.find(key);
         if(configs_itr == configs.end()) return {possible_states, 1.0 / possible_states.size()};
 
-        std::map<double, std::set<state_type>> likelihoods;
         for(const state_type &state : possible_states)
-            likelihoods[count_in_configs(key, state)].insert(state);
-        auto itr = likelihoods.rbegin();
-        assert(itr != likelihoods.rend());
-        return {itr->second, ((double)itr->first)/root->num_leaves};
+            counts.push_back(count_in_configs(key, state));
+        return most_likely_of(counts);
+    }
+
+    // Requires the number of keys in the given state, known or not, to stay between min and max.
+    // The bound is remembered and enforced on every key added later, so repeating it is free.
+    void constrain_count(const state_type &state, int min, int max) {
+        check_usable();
+        if(possible_states.find(state) == possible_states.end()) illegal_state();
+        if(!tighten_count(state, min, max)) return;
+        deduce();
+        compact_if_grown();
     }
 
     void constrain_one_of(const state_type &state) {
-        constrain_all(state, 1, false);
+        constrain_count(state, 1, 1);
+    }
+
+    // Weighs every unknown key in the given state by density / (1 - density) relative to any
+    // other state, so that probabilities follow a prior instead of counting configurations evenly
+    void set_density(const state_type &state, double density) {
+        check_usable();
+        if(possible_states.find(state) == possible_states.end()) illegal_state();
+        assert(density > 0 && density < 1);
+        tracked[track(state)].odds = density / (1 - density);
+        recount(root);
     }
 
     void constrain_none_of(const std::set<key_type> &keys, const state_type &state) {
@@ -115,13 +248,112 @@ public:
         constrain_together(keys, state, 1, true);
     }
 
+    // Applies the constraints in the transaction in as few passes over the tree as its count bounds
+    // allow and deduces once, leaving the same configurations as applying them one call at a time.
+    // A count bound's minimum holds only for the keys named before it, so the constraints before
+    // each count are applied together and the count then prunes the tree as constrain_count would.
+    void commit(const ConstraintTransaction<key_type, state_type> &transaction) {
+        typedef ConstraintTransaction<key_type, state_type> transaction_type;
+        check_usable();
+        size_t num_constraints = transaction.end() - transaction.begin(), num_keys = 0;
+        for(const auto &c : transaction) { // before anything changes, so a bad state leaves no trace
+            if(possible_states.find(c.state) == possible_states.end()) illegal_state();
+            num_keys += c.keys.size();
+        }
+        std::vector<group> &groups = commit_groups;
+        std::vector<std::pair<key_type, int>> &hits = commit_hits;
+        if(groups.capacity() < num_constraints || hits.capacity() < num_keys) {
+            AllocationCheck::Exempt growth; // the largest transaction yet
+            groups.reserve(num_constraints);
+            hits.reserve(num_keys);
+            commit_found.reserve(num_constraints);
+        }
+        groups.clear();
+        hits.clear();
+        int deepest = 0;
+
+        for(const auto &c : transaction) {
+            if(c.kind == transaction_type::COUNT) {
+                apply_groups(deepest);
+                tighten_count(c.state, c.min, c.max);
+                continue;
+            }
+
+            group g;
+            g.state = c.state;
+            g.each = (c.kind == transaction_type::ALL_OF) || (c.kind == transaction_type::NONE_OF);
+            g.equal = c.kind != transaction_type::NONE_OF;
+            int found = 0;
+            size_t first_hit = hits.size();
+            for(const key_type &key : c.keys) {
+                auto known_itr = known.find(key);
+                if(known_itr != known.end()) { // if known
+                    if(g.each && (g.equal == (known_itr->second != c.state)))
+                        illegal_constraint();
+                    if(!g.each && (known_itr->second == c.state)) {
+                        ++found;
+                        if((c.kind == transaction_type::ONE_OF) && (found > 1))
+                            illegal_constraint();
+                    }
+                } else { // if not known
+                    add_key(key);
+                    hits.emplace_back(key, (int)groups.size());
+                    deepest = std::max(deepest, depth_of(key));
+                }
+            }
+            if(!g.each && hits.size() == first_hit && found < 1) illegal_constraint(); // every key is known
+            g.min = 1 - found;
+            g.max = c.kind == transaction_type::AT_LEAST_ONE_OF ? INT_MAX : 1 - found;
+            groups.push_back(g);
+        }
+
+        apply_groups(deepest);
+        deduce();
+        compact_if_grown();
+    }
+
+    // Folds every unknown key that the other keys don't constrain, meaning every configuration allows
+    // each of its values, out of the tree. Counts for the remaining keys stay exact, and a folded key
+    // still answers queries from the values it can take. A constraint naming it again, or a count bound
+    // on one of its values, puts it back. Keys that may take a state under a count bound never fold,
+    // since the bound ties them to every other key. Returns the keys folded by this call.
+    std::vector<key_type> fold_independent() {
+        check_usable();
+        std::vector<node*> levels = level_headers();
+        std::vector<key_type> keys;
+        std::vector<std::set<state_type>> values;
+        independent_levels(levels, keys, values);
+        for(int i = 0; i < (int)keys.size(); ++i) {
+            remove_list(keys[i]);
+            folded[keys[i]] = values[i];
+        }
+        return keys;
+    }
+
+    // Every key currently folded out of the tree, with the values it can take
+    const std::map<key_type, std::set<state_type>> &folded_keys() const {
+        return folded;
+    }
+
+    // Independent keys are folded whenever the tree holds more than this many nodes. Zero turns
+    // folding off, though fold_independent can still be called.
+    void set_fold_threshold(size_t nodes) {
+        fold_threshold = nodes;
+    }
+
+    // The tree reorders its levels once it holds more than this many nodes, and then waits until
+    // it has doubled again. Zero, the default, turns reordering off.
+    void set_reorder_threshold(size_t nodes) {
+        reorder_threshold = nodes;
+    }
+
     void print() const {
         std::cout << "Knowns: ------------------" << std::endl;
         for(auto s : known)
             std::cout << s.first << ": " << s.second << ", " << std::endl;
         std::cout << std::endl << "Configurations: ------------------" << std::endl;
         int count = 0;
-        for(node* c : root->children) print_configs(c, "", count);
+        if(root) for(node* c : root->children) print_configs(c, "", count);
         std::cout << "-------------------------------------------" << std::endl;
     }
 
@@ -129,16 +361,39 @@ private:
 
     std::set<state_type> possible_states;
     std::map<key_type, state_type> known;
+    std::vector<key_type> known_log;
     std::map<key_type, node*> configs;
     node *root, *last_level;
 
+    // A state counted along every branch, for global cardinality bounds and density priors
+    struct tracked_state {
+        state_type state;
+        int min, max;
+        double odds;
+    };
+    std::vector<tracked_state> tracked;
+    std::vector<int> known_tally;
+
+    std::map<key_type, std::set<state_type>> folded;
+
+    // When each unknown key was last named by a constraint, for choosing which levels sit deepest
+    std::map<key_type, long long> last_named;
+    long long name_clock;
+    size_t fold_threshold, reorder_threshold;
+    std::vector<double> odds_sums; // for_each_odds' weight of each state on one level
+    static constexpr size_t DEFAULT_FOLD_THRESHOLD = 256;
+    static constexpr size_t DEFAULT_REORDER_THRESHOLD = 0; // off, since sifting showed no gain on the robot's trees
+    static constexpr double MAX_SIFT_GROWTH = 1.1;
+    static constexpr size_t SIFT_BUDGET = 4; // nodes a sift may move, in tree sizes
+    static constexpr double SETTLE_WEIGHT = 0.1; // how much a recently named key pays to sit near the root
+
     // LOGIC FUNCTIONS
 
     void deduce() {
         auto itr = configs.begin();
         while(itr != configs.end()) {
             node *n = itr->second->next;
-            const state_type &state = n->value;
+            state_type state = n->value; // a copy, since set_known deletes n
             bool all_same = true;
             while(n) {
                 if(n->value != state) {
@@ -154,6 +409,7 @@ private:
     }
 
     void constrain_each(const std::set<key_type> &keys, const state_type &state, bool is_equal) {
+        check_usable();
         if(possible_states.find(state) == possible_states.end()) illegal_state();
         for(const key_type &key : keys) {
             auto itr = known.find(key);
@@ -174,9 +430,11 @@ private:
             }
         }
         deduce();
+        compact_if_grown();
     }
 
     void constrain_together(const std::set<key_type> &keys, const state_type &state, int min, bool greater) {
+        check_usable();
         if(possible_states.find(state) == possible_states.end()) illegal_state();
         int found = 0;
         std::set<key_type> unknowns;
@@ -193,11 +451,13 @@ private:
                 add_key(key);
             }
         }
+        if(unknowns.empty() && found < min) illegal_constraint(); // every key is known
 
         auto children = root->children;
         for(node* c : children)
             constrain_together_rec(c, found, unknowns, state, min, greater);
         deduce();
+        compact_if_grown();
     }
 
     void constrain_together_rec(node* n, int found, const std::set<key_type> &keys,
@@ -218,63 +478,194 @@ private:
             constrain_together_rec(c, found, keys, state, min, greater);
     }
 
-    void constrain_all(const state_type &state, int min, bool greater) {
-        if(possible_states.find(state) == possible_states.end()) illegal_state();
-        int found = 0;
-        for(const auto &pair : known) {
-            if(pair.second == state) {
-                ++found;
-                if(!greater && (found > min)) illegal_constraint();
-            }
+    // A constraint of a transaction. Each of its keys must match it on its own, or the number of
+    // its keys in the state must lie between min and max.
+    struct group {
+        state_type state;
+        bool each, equal;
+        int min, max;
+    };
+
+    // commit's scratch, kept between calls so that committing only allocates as the tree grows
+    std::vector<group> commit_groups;
+    std::vector<std::pair<key_type, int>> commit_hits; // each unknown key named and its group, by key
+    std::vector<int> commit_found;
+
+    // Calls visit on each child of n. A child's branch can only take n with it when it is the last
+    // child, so the next child is read first and the loop stops after the last, without copying.
+    template<class Visit>
+    void for_each_child(node *n, Visit visit) {
+        auto itr = n->children.begin();
+        while(itr != n->children.end()) {
+            node *c = *itr++;
+            bool last = itr == n->children.end();
+            visit(c);
+            if(last) break;
         }
+    }
 
-        auto children = root->children;
-        for(node* c : children)
-            constrain_all_rec(c, found, state, min, greater);
-        deduce();
+    // Prunes the tree by commit's pending groups in one pass and clears them
+    void apply_groups(int &deepest) {
+        if(commit_groups.empty()) return;
+        std::sort(commit_hits.begin(), commit_hits.end());
+        commit_found.assign(commit_groups.size(), 0);
+        for_each_child(root, [this, deepest](node *c) { commit_rec(c, 1, deepest); });
+        commit_groups.clear();
+        commit_hits.clear();
+        deepest = 0;
     }
 
-    void constrain_all_rec(node* n, int found, const state_type &state, int min, bool greater) {
-        if(n->value == state) {
-            ++found;
-            if(!greater && (found > min)) {
-                delete_branch(n);
-                return;
-            }
+    void commit_rec(node* n, int depth, int deepest) {
+        const std::vector<group> &groups = commit_groups;
+        std::vector<int> &found = commit_found;
+        auto first = std::lower_bound(commit_hits.begin(), commit_hits.end(), std::make_pair(n->key, INT_MIN));
+        auto last = first;
+        while(last != commit_hits.end() && last->first == n->key) ++last;
+        state_type value = n->value; // a copy, since n may be deleted below
+        bool keep = true;
+        for(auto h = first; h != last; ++h) {
+            int g = h->second;
+            if(groups[g].each) {
+                if(groups[g].equal == (value != groups[g].state)) keep = false;
+            } else if((value == groups[g].state) && (found[g] + 1 > groups[g].max)) keep = false;
         }
-        if((n->children.size() == 0) && (found < min)) {
+        if(!keep) {
             delete_branch(n);
             return;
         }
-        auto children = n->children;
-        for(node* c : children)
-            constrain_all_rec(c, found, state, min, greater);
+
+        for(auto h = first; h != last; ++h)
+            if(!groups[h->second].each && (value == groups[h->second].state)) ++found[h->second];
+
+        if((n->children.size() == 0) || (depth >= deepest)) { // every count is final here
+            for(int g = 0; g < (int)groups.size(); ++g)
+                if(!groups[g].each && (found[g] < groups[g].min)) keep = false;
+        } else for_each_child(n, [this, depth, deepest](node *c) { commit_rec(c, depth + 1, deepest); });
+
+        for(auto h = first; h != last; ++h)
+            if(!groups[h->second].each && (value == groups[h->second].state)) --found[h->second];
+        if(!keep) delete_branch(n);
+    }
+
+    // Number of levels from the root down to the key's level
+    int depth_of(const key_type &key) const {
+        node *n = configs.find(key)->second->next;
+        int depth = 0;
+        while(n != root) {
+            n = n->parent;
+            ++depth;
+        }
+        return depth;
+    }
+
+    // Narrows the state's count bounds and prunes the branches that break them, with the minimum
+    // checked against the keys in the tree now. Returns false if the bounds were already as narrow.
+    bool tighten_count(const state_type &state, int min, int max) {
+        int i = track(state);
+        tracked_state &t = tracked[i];
+        if(min <= t.min && max >= t.max) return false;
+        unfold_with(state);
+        t.min = std::max(t.min, min);
+        t.max = std::min(t.max, max);
+        if(known_tally[i] > t.max) illegal_constraint();
+
+        if(root->children.empty() && known_tally[i] < t.min) illegal_constraint(); // no key left to hold it
+        for_each_child(root, [this, i](node *c) { constrain_count_rec(c, i); });
+        return true;
+    }
+
+    void constrain_count_rec(node* n, int i) {
+        const tracked_state &t = tracked[i];
+        int found = known_tally[i] + n->tally[i];
+        if((found > t.max) || ((n->children.size() == 0) && (found < t.min))) {
+            delete_branch(n);
+            return;
+        }
+        for_each_child(n, [this, i](node *c) { constrain_count_rec(c, i); });
+    }
+
+    // Starts counting a state along every branch and returns its index in tracked
+    int track(const state_type &state) {
+        int i = tracked_index(state);
+        if(i >= 0) return i;
+        if((int)tracked.size() == node::MAX_TRACKED) throw LogicError("Too many states have counts or densities!");
+        AllocationCheck::Exempt growth; // a new tracked state
+        tracked.push_back({state, 0, INT_MAX, 1});
+        int found = 0;
+        for(const auto &pair : known)
+            if(pair.second == state) ++found;
+        known_tally.push_back(found);
+        recount(root);
+        return (int)tracked.size() - 1;
+    }
+
+    int tracked_index(const state_type &state) const {
+        for(int i = 0; i < (int)tracked.size(); ++i)
+            if(tracked[i].state == state) return i;
+        return -1;
+    }
+
+    bool exceeds_bounds(const node* n) const {
+        for(int i = 0; i < (int)tracked.size(); ++i)
+            if(known_tally[i] + n->tally[i] > tracked[i].max) return true;
+        return false;
+    }
+
+    double leaf_weight(const node* n) const {
+        double w = 1;
+        for(int i = 0; i < (int)tracked.size(); ++i)
+            if(tracked[i].odds != 1) w *= std::pow(tracked[i].odds, n->tally[i]);
+        return w;
     }
 
     // GRAPH MANIPULATION FUNCTION
 
     node* add_key(const key_type &key) {
         auto itr = configs.find(key);
-        if(itr != configs.end()) return itr->second;
+        if(itr != configs.end()) {
+            last_named[key] = ++name_clock;
+            return itr->second;
+        }
+        AllocationCheck::Exempt growth; // a new level
+        last_named[key] = ++name_clock;
+        std::set<state_type> values = possible_states;
+        auto fold_itr = folded.find(key);
+        if(fold_itr != folded.end()) { // a folded key comes back with the values it had left
+            values.swap(fold_itr->second);
+            folded.erase(fold_itr);
+        }
         node *p = last_level->next;
         last_level = new node();
         last_level->key = key;
         configs[key] = last_level;
         node *l = last_level;
+        std::vector<node*> dead_ends;
 
         while(p) {
-            for(const state_type &state : possible_states) {
+            for(const state_type &state : values) {
                 node* m = new node(key, state);
+                m->tally = p->tally;
+                for(int i = 0; i < (int)tracked.size(); ++i)
+                    if(tracked[i].state == state) ++m->tally[i];
+                if(exceeds_bounds(m)) { // never grow a branch that breaks a cardinality bound
+                    delete m;
+                    continue;
+                }
+                m->weight = leaf_weight(m);
                 m->parent = p;
                 m->last = l;
                 l->next = m;
                 l = m;
                 p->children.insert(m);
             }
-            update_num_leaves(p);
+            if(p == root && p->children.empty()) illegal_constraint(); // no configuration is left
+            if(p->children.empty()) dead_ends.push_back(p);
+            else update_num_leaves(p);
             p = p->next;
         }
 
+        for(node* d : dead_ends) delete_branch(d);
+
         return last_level;
     }
 
@@ -302,14 +693,16 @@ private:
         if(n->next) n->next->last = n->last;
     }
 
-    void merge_subtree(node* p, node* q) {
+    // Returns true if any of q's children collided with one of p's
+    bool merge_subtree(node* p, node* q) {
+        bool collided = false;
         auto children = q->children;
         for(node* qc : children) {
             bool found = false;
             for(node *pc : p->children) {
                 if(pc->value == qc->value) {
                     merge_subtree(pc, qc);
-                    found = true;
+                    found = collided = true;
                     break;
                 }
             }
@@ -321,6 +714,7 @@ private:
 
         remove_node_from_list(q);
         delete q;
+        return collided;
     }
 
     void remove_list(const key_type &key) {
@@ -328,55 +722,386 @@ private:
         if(itr == configs.end()) return;
 
         node *n = itr->second;
-        if(n == last_level) last_level = n->next->parent->last;
+        if(n == last_level) { // the level above becomes the last, so find its header
+            last_level = n->next->parent;
+            while(last_level->last) last_level = last_level->last;
+        }
         n = n->next;
-        node *p = n->parent;
 
-        while(p) {
-            p->children.clear();
-            p = p->next;
-        }
+        // Merging reorders children, so a level's list need not follow its parents' order
+        for(node *m = n; m; m = m->next)
+            m->parent->children.clear();
 
+        // Counts below the level only go stale if subtrees merged or a tracked state left the tree
+        bool stale = false;
         while(n) {
             node *m = n;
             n = n->next;
-            merge_subtree(m->parent, m);
+            if(tracked_index(m->value) >= 0) stale = true;
+            if((m->children.size() == 0) && (m->parent->num_leaves > 1)) stale = true; // sibling leaves collapse
+            if(merge_subtree(m->parent, m)) stale = true;
         }
 
         delete itr->second;
         configs.erase(itr);
+        last_named.erase(key);
+
+        if(stale) {
+            recount(root);
+            if(!tracked.empty()) {
+                auto children = root->children;
+                for(node* c : children)
+                    prune_exceeding_rec(c);
+            }
+        }
+    }
+
+    // LEVEL ORDER
+
+    // The level headers from the root down
+    std::vector<node*> level_headers() const {
+        std::vector<node*> levels;
+        for(node *n = last_level->next; n && n != root; n = n->parent)
+            levels.push_back(configs.find(n->key)->second);
+        std::reverse(levels.begin(), levels.end());
+        return levels;
+    }
+
+    size_t tree_size(const std::vector<node*> &levels) const {
+        size_t size = 0;
+        for(node *header : levels)
+            for(node *n = header->next; n; n = n->next) ++size;
+        return size;
+    }
+
+    // Folds independent keys once the tree passes fold_threshold nodes, and sifts it once it passes
+    // reorder_threshold, after which sifting waits for the tree to double again
+    void compact_if_grown() {
+        if(!root) return;
+        size_t bound = (size_t)root->num_leaves * configs.size(); // the node count can't be higher
+        bool fold = fold_threshold > 0 && bound > fold_threshold;
+        bool reorder = reorder_threshold > 0 && bound > reorder_threshold;
+        if(!fold && !reorder) return;
+        AllocationCheck::Exempt growth; // compacting rebuilds the tree's levels
+
+        std::vector<node*> levels = level_headers();
+        size_t size = tree_size(levels);
+        if(fold && size > fold_threshold && !fold_independent().empty()) {
+            levels = level_headers();
+            size = tree_size(levels);
+        }
+        if(reorder && size > reorder_threshold && levels.size() > 1) {
+            size = sift(levels, size);
+            reorder_threshold = std::max(reorder_threshold, 2 * size);
+        }
+    }
+
+    // A level is independent when every node above it has children with the same values, each
+    // heading an identical subtree. Only levels whose node count allows that are compared.
+    void independent_levels(const std::vector<node*> &levels, std::vector<key_type> &keys,
+                            std::vector<std::set<state_type>> &values) const {
+        std::vector<std::set<state_type>> level_values(levels.size());
+        std::vector<bool> possible(levels.size(), false);
+        int shallowest = (int)levels.size();
+        size_t count_above = 1;
+        for(int d = 0; d < (int)levels.size(); ++d) {
+            size_t count = 0;
+            bool bounded = false, uneven = false;
+            for(node *n = levels[d]->next; n; n = n->next) {
+                ++count;
+                level_values[d].insert(n->value);
+                if(n->num_leaves != (*n->parent->children.begin())->num_leaves) uneven = true;
+            }
+            for(const state_type &value : level_values[d]) {
+                int i = tracked_index(value);
+                if(i >= 0 && (tracked[i].min > 0 || tracked[i].max < INT_MAX)) bounded = true;
+            }
+            possible[d] = !bounded && !uneven && level_values[d].size() >= 2
+                          && count == count_above * level_values[d].size();
+            if(possible[d]) shallowest = std::min(shallowest, d);
+            count_above = count;
+        }
+
+        std::map<const node*, int> id;
+        std::map<std::vector<int>, int> below_ids; // the ids of a node's children, sorted
+        std::map<std::pair<state_type, int>, int> ids;
+        std::map<const node*, int> below;
+        for(int d = (int)levels.size() - 1; d >= shallowest; --d) {
+            for(node *n = levels[d]->next; n; n = n->next) {
+                std::vector<int> children;
+                for(node *c : n->children) children.push_back(id[c]);
+                std::sort(children.begin(), children.end());
+                auto b = below_ids.emplace(children, (int)below_ids.size()).first->second;
+                below[n] = b;
+                id[n] = ids.emplace(std::make_pair(n->value, b), (int)ids.size()).first->second;
+            }
+            if(!possible[d]) continue;
+
+            bool independent = true;
+            std::set<node*> parents;
+            for(node *n = levels[d]->next; n; n = n->next) parents.insert(n->parent);
+            for(node *p : parents) {
+                std::set<state_type> child_values;
+                for(node *c : p->children) {
+                    child_values.insert(c->value);
+                    if(below[c] != below[*p->children.begin()]) independent = false;
+                }
+                if(child_values != level_values[d]) independent = false;
+                if(!independent) break;
+            }
+            if(!independent) continue;
+            keys.push_back(levels[d]->key);
+            values.push_back(level_values[d]);
+        }
+    }
+
+    // The prior weight of one key taking the value, relative to a state with no density
+    double value_odds(const state_type &value) const {
+        int i = tracked_index(value);
+        return i < 0 ? 1 : tracked[i].odds;
+    }
+
+    // Puts back every folded key that could take the state, before a count bound is placed on it
+    void unfold_with(const state_type &state) {
+        AllocationCheck::Exempt growth; // the keys come back as new levels
+        std::vector<key_type> keys;
+        for(const auto &pair : folded)
+            if(pair.second.find(state) != pair.second.end()) keys.push_back(pair.first);
+        for(const key_type &key : keys) add_key(key);
+    }
+
+    // Moves each key, least recently named first, through every depth and leaves it where the tree
+    // was smallest, with recently named keys charged more for sitting far from the leaves.
+    // Stops once it has moved SIFT_BUDGET times as many nodes as the tree held.
+    size_t sift(std::vector<node*> &levels, size_t size) {
+        std::vector<std::pair<long long, key_type>> keys;
+        for(node *header : levels) keys.emplace_back(last_named[header->key], header->key);
+        std::sort(keys.begin(), keys.end());
+
+        int depth = (int)levels.size() - 1;
+        size_t moved = 0, budget = SIFT_BUDGET * size;
+        for(int i = 0; i < (int)keys.size() && moved < budget; ++i) {
+            double recency = (double)i / depth;
+            auto cost = [&](int pos, size_t size) {
+                return size * (1 + SETTLE_WEIGHT * recency * (depth - pos) / depth);
+            };
+            int pos = 0;
+            while(levels[pos]->key != keys[i].second) ++pos;
+            int best_pos = pos;
+            size_t best = size;
+            double best_cost = cost(pos, size);
+            while(pos + 1 < (int)levels.size() && size <= best * MAX_SIFT_GROWTH) {
+                size += swap_levels(levels, pos++, moved);
+                if(cost(pos, size) <= best_cost) {
+                    best = size;
+                    best_cost = cost(pos, size);
+                    best_pos = pos;
+                }
+            }
+            while(pos > best_pos) size += swap_levels(levels, --pos, moved);
+            while(pos > 0 && size <= best * MAX_SIFT_GROWTH) {
+                size += swap_levels(levels, --pos, moved);
+                if(cost(pos, size) < best_cost) {
+                    best = size;
+                    best_cost = cost(pos, size);
+                    best_pos = pos;
+                }
+            }
+            while(pos < best_pos) size += swap_levels(levels, pos++, moved);
+        }
+        return size;
+    }
+
+    // Swaps the levels at indexes d and d + 1 of levels and returns the change in the node count,
+    // adding the lower level's nodes to moved.
+    // Below each node above them, the paths are regrouped by their value at the lower level. The
+    // lower level's nodes are kept and given the upper key, so everything beneath them stays put
+    // and only the upper level's nodes are made anew.
+    long long swap_levels(std::vector<node*> &levels, int d, size_t &moved) {
+        node *upper = levels[d], *lower = levels[d + 1];
+        std::vector<node*> parents;
+        if(d == 0) parents.push_back(root);
+        else for(node *p = levels[d - 1]->next; p; p = p->next) parents.push_back(p);
+
+        long long change = 0;
+        node *upper_tail = lower, *lower_tail = upper; // the headers trade levels too
+        for(node *p : parents) {
+            // the paths below p as (upper value, lower node) before any node is reused
+            std::vector<node*> firsts(p->children.begin(), p->children.end());
+            std::vector<std::pair<state_type, node*>> paths;
+            for(node *a : firsts)
+                for(node *b : a->children) paths.emplace_back(a->value, b);
+            p->children.clear();
+            moved += paths.size();
+
+            std::vector<node*> made;
+            for(const auto &path : paths) {
+                node *b = path.second, *nb = nullptr;
+                for(node *m : made) {
+                    if(m->value == b->value) {
+                        nb = m;
+                        break;
+                    }
+                }
+                if(!nb) { // the old upper nodes below p are reused before new ones are made
+                    if(made.size() < firsts.size()) {
+                        nb = firsts[made.size()];
+                        nb->children.clear();
+                    } else nb = new node();
+                    nb->key = lower->key;
+                    nb->value = b->value;
+                    nb->parent = p;
+                    nb->tally = p->tally;
+                    for(int i = 0; i < (int)tracked.size(); ++i)
+                        if(tracked[i].state == b->value) ++nb->tally[i];
+                    nb->num_leaves = 0;
+                    nb->weight = 0;
+                    p->children.insert(nb);
+                    made.push_back(nb);
+                    nb->last = upper_tail;
+                    upper_tail->next = nb;
+                    upper_tail = nb;
+                }
+                b->key = upper->key;
+                b->value = path.first;
+                b->parent = nb;
+                nb->children.insert(b);
+                nb->num_leaves += b->num_leaves;
+                nb->weight += b->weight;
+                b->last = lower_tail;
+                lower_tail->next = b;
+                lower_tail = b;
+            }
+            for(size_t i = made.size(); i < firsts.size(); ++i) delete firsts[i];
+            change += (long long)made.size() - (long long)firsts.size();
+        }
+        upper_tail->next = nullptr;
+        lower_tail->next = nullptr;
+
+        std::swap(levels[d], levels[d + 1]);
+        if(last_level == lower) last_level = upper;
+        return change;
     }
 
     void update_num_leaves(node* n) {
         if(!n) return;
         n->num_leaves = 0;
-        for(auto c : n->children)
+        n->weight = 0;
+        for(auto c : n->children) {
             n->num_leaves += c->num_leaves;
+            n->weight += c->weight;
+        }
         update_num_leaves(n->parent);
     }
 
+    // Recomputes tallies from the root down and leaf counts and weights from the leaves up
+    void recount(node* n) {
+        if(n == root) n->tally.fill(0);
+        else {
+            n->tally = n->parent->tally;
+            for(int i = 0; i < (int)tracked.size(); ++i)
+                if(tracked[i].state == n->value) ++n->tally[i];
+        }
+
+        if(n->children.size() == 0) {
+            n->num_leaves = 1;
+            n->weight = leaf_weight(n);
+            return;
+        }
+        n->num_leaves = 0;
+        n->weight = 0;
+        for(node* c : n->children) {
+            recount(c);
+            n->num_leaves += c->num_leaves;
+            n->weight += c->weight;
+        }
+    }
+
+    void prune_exceeding_rec(node* n) {
+        if(exceeds_bounds(n)) {
+            delete_branch(n);
+            return;
+        }
+        auto children = n->children;
+        for(node* c : children)
+            prune_exceeding_rec(c);
+    }
+
     // OTHER FUNCTIONS
 
-    int count_in_configs(const key_type &key, const state_type &state) {
+    // The states whose counts, in possible_states order, are the highest, and their probability.
+    // Counts within rounding of the highest tie with it.
+    std::pair<std::set<state_type>, double> most_likely_of(const std::vector<double> &counts) const {
+        double highest = *std::max_element(counts.begin(), counts.end());
+        std::set<state_type> states;
+        auto itr = possible_states.begin();
+        for(double count : counts) {
+            if(count >= highest * (1 - 1e-12)) states.insert(*itr);
+            ++itr;
+        }
+        return {states, highest / root->weight};
+    }
+
+    double count_in_configs(const key_type &key, const state_type &state) {
         auto itr = configs.find(key);
         assert(itr != configs.end());
-        int sum = 0;
+        double sum = 0;
         node *n = itr->second->next;
         while(n) {
-            if(n->value == state) sum += n->num_leaves;
+            if(n->value == state) sum += n->weight;
             n = n->next;
         }
         return sum;
     }
 
+    // A contradiction can be found halfway through a constraint, so the tree is released rather than
+    // left half pruned. The knowns stay readable, but further constraints throw until reassigned.
     void illegal_constraint() {
-        std::cerr << "You have provided conflicting information!" << std::endl;
-        exit(1);
+        release();
+        throw LogicError("You have provided conflicting information!");
     }
 
     void illegal_state() {
-        std::cerr << "You provided a state that wasn't one of the possible states you specified!" << std::endl;
-        exit(1);
+        throw LogicError("You provided a state that wasn't one of the possible states you specified!");
+    }
+
+    void check_usable() {
+        if(!root) throw LogicError("The logic engine was released after conflicting information!");
+    }
+
+    void release() {
+        if(!root) return;
+        for(auto &pair : configs) delete pair.second;
+        delete root->last;
+        delete_subtree(root);
+        configs.clear();
+        folded.clear(); // nothing is left for the queries to weigh a folded key against
+        last_named.clear();
+        tracked.clear();
+        known_tally.clear();
+        root = last_level = nullptr;
+    }
+
+    void delete_subtree(node* n) {
+        for(node* c : n->children) delete_subtree(c);
+        delete n;
+    }
+
+    void swap(LogicEngine &other) {
+        std::swap(possible_states, other.possible_states);
+        std::swap(known, other.known);
+        std::swap(known_log, other.known_log);
+        std::swap(configs, other.configs);
+        std::swap(root, other.root);
+        std::swap(last_level, other.last_level);
+        std::swap(tracked, other.tracked);
+        std::swap(known_tally, other.known_tally);
+        std::swap(folded, other.folded);
+        std::swap(last_named, other.last_named);
+        std::swap(name_clock, other.name_clock);
+        std::swap(fold_threshold, other.fold_threshold);
+        std::swap(reorder_threshold, other.reorder_threshold);
+        std::swap(odds_sums, other.odds_sums);
     }
 
     void print_configs(node* n, std::string str, int &count) const {
@@ -1,26 +1,113 @@
 #include <iostream>
+#include <memory>
+#include <algorithm>
 #include "robot_agent.h"
 #include "human_agent.h"
 #include "my_agent.h"
+#include "diagram_engine.h"
+#include "engine_checker.h"
+
+std::unique_ptr<Game> make_agent(const std::string &name) {
+    if(name == "robot") return std::unique_ptr<Game>(new RobotAgent());
+    if(name == "robot-diagram")
+        return std::unique_ptr<Game>(new BasicRobotAgent<DiagramEngine<std::pair<int, int>, CELL>, NearestSafeTarget>());
+    if(name == "robot-gain")
+        return std::unique_ptr<Game>(new BasicRobotAgent<LogicEngine<std::pair<int, int>, CELL>, InformationGainTarget>());
+    if(name == "human") return std::unique_ptr<Game>(new HumanAgent());
+    if(name == "myagent") return std::unique_ptr<Game>(new MyAgent());
+    std::cerr << "Unknown agent " << name << "!" << std::endl;
+    exit(1);
+}
+
+// Plays every game file without printing and reports each outcome and the merged move latency
+int run_batch(int argc, char *argv[]) {
+    std::string agent_name = argv[2];
+    std::chrono::nanoseconds deadline = std::chrono::nanoseconds::zero();
+    OVERRUN overrun = LOG_ONLY;
+    int first_file = 3;
+    if(argc >= 4 && std::string(argv[3]) == "--deadline") {
+        std::string micros = argc >= 5 ? argv[4] : "", action = argc >= 6 ? argv[5] : "";
+        if(micros.empty() || micros.find_first_not_of("0123456789") != std::string::npos || micros.size() > 12
+           || std::stoll(micros) == 0) {
+            std::cerr << "The deadline should be a positive number of microseconds!" << std::endl;
+            return 1;
+        }
+        deadline = std::chrono::microseconds(std::stoll(micros));
+        if(action == "log") overrun = LOG_ONLY;
+        else if(action == "forfeit") overrun = FORFEIT;
+        else if(action == "default") overrun = DEFAULT_MOVE;
+        else {
+            std::cerr << "The deadline action should be log, forfeit or default!" << std::endl;
+            std::cerr << "./wumpus.out batch robot --deadline 1000 forfeit game1.txt game2.txt" << std::endl;
+            return 1;
+        }
+        first_file = 6;
+    }
+
+    LatencyHistogram latency;
+    int won = 0;
+    for(int i = first_file; i < argc; ++i) {
+        std::unique_ptr<Game> agent = make_agent(agent_name);
+        agent->set_quiet(true);
+        if(deadline > std::chrono::nanoseconds::zero()) agent->set_deadline(deadline, overrun);
+        GameResult result = agent->run_game(argv[i]);
+        if(result.won) ++won;
+        latency.merge(result.latency);
+        if(!result.error.empty()) {
+            std::cout << argv[i] << ": FAILED: " << result.error << std::endl;
+            continue;
+        }
+        std::cout << argv[i] << ": " << result.msg << " (" << result.moves << " moves, ";
+        result.latency.print(std::cout);
+        std::cout << ")" << std::endl;
+    }
+    std::cout << "Won " << won << " of " << argc - first_file << " games. Move latency: ";
+    latency.print(std::cout);
+    std::cout << std::endl;
+    return 0;
+}
+
+// Checks the engines against each other and returns 1 if they disagreed on any sequence
+int run_check(int argc, char *argv[]) {
+    std::vector<std::string> args(argv + 2, argv + argc);
+    bool force_compaction = std::find(args.begin(), args.end(), "--force-compaction") != args.end();
+    args.erase(std::remove(args.begin(), args.end(), "--force-compaction"), args.end());
+    for(const std::string &arg : args) {
+        if(args.size() > 2 || arg.empty() || arg.find_first_not_of("0123456789") != std::string::npos || arg.size() > 9) {
+            std::cerr << "The check command takes the number of sequences and the seed as whole numbers!" << std::endl;
+            std::cerr << "./wumpus.out check 100 0 --force-compaction" << std::endl;
+            return 1;
+        }
+    }
+    int num_sequences = args.size() >= 1 ? std::stoi(args[0]) : 100;
+    unsigned seed = args.size() >= 2 ? (unsigned)std::stoul(args[1]) : 0;
+    EngineChecker<LogicEngine<std::pair<int, int>, CELL>, DiagramEngine<std::pair<int, int>, CELL>> checker(seed);
+    if(force_compaction) checker.force_compaction();
+    return checker.run(num_sequences, std::cout) == 0 ? 0 : 1;
+}
 
 int main(int argc, char *argv[]) {
+    if(argc >= 2 && std::string(argv[1]) == "check") return run_check(argc, argv);
+
+    if(argc >= 3 && std::string(argv[1]) == "batch") return run_batch(argc, argv);
+
     if(argc < 3) {
         std::cerr << "Please provide a game file and agent name!" << std::endl;
         std::cerr << "Example inputs:" << std::endl;
         std::cerr << "./wumpus.out game1.txt robot" << std::endl;
+        std::cerr << "./wumpus.out game1.txt robot-diagram" << std::endl;
+        std::cerr << "./wumpus.out game1.txt robot-gain" << std::endl;
         std::cerr << "./wumpus.out game1.txt human" << std::endl;
         std::cerr << "./wumpus.out game1.txt myagent" << std::endl;
+        std::cerr << "./wumpus.out batch robot game1.txt game2.txt" << std::endl;
+        std::cerr << "./wumpus.out check 100" << std::endl;
+        std::cerr << "./wumpus.out check 100 0 --force-compaction" << std::endl;
         exit(1);
     }
 
-    if(std::string(argv[2]) == "robot"){
-        RobotAgent agent;
-        agent.run_game(argv[1]);
-    } else if(std::string(argv[2]) == "human"){
-        HumanAgent agent;
-        agent.run_game(argv[1]);
-    } else if(std::string(argv[2]) == "myagent"){
-        MyAgent agent;
-        agent.run_game(argv[1]);
+    GameResult result = make_agent(argv[2])->run_game(argv[1]);
+    if(!result.error.empty()) {
+        std::cerr << result.error << std::endl;
+        return 1;
     }
-}
\ No newline at end of file
+}
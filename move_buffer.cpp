@@ -0,0 +1,39 @@
+#include <cassert>
+#include "move_buffer.h"
+
+void MoveBuffer::reserve(size_t n) {
+    if(n <= ring.size()) return;
+    size_t capacity = 8;
+    while(capacity < n) capacity *= 2;
+    std::vector<Move> bigger(capacity, Move(false, DIRECTION::UP));
+    for(size_t i = 0; i < count; ++i) bigger[i] = ring[(head + i) & mask];
+    ring.swap(bigger);
+    head = 0;
+    mask = capacity - 1;
+}
+
+void MoveBuffer::push_front(const Move &move) {
+    reserve(count + 1);
+    head = (head + mask) & mask;
+    ring[head] = move;
+    ++count;
+}
+
+void MoveBuffer::push_back(const Move &move) {
+    reserve(count + 1);
+    ring[(head + count) & mask] = move;
+    ++count;
+}
+
+void MoveBuffer::pop_front() {
+    assert(count > 0);
+    head = (head + 1) & mask;
+    --count;
+}
+
+void MoveBuffer::insert_before_back(const Move &move) {
+    assert(count > 0);
+    Move last = back();
+    ring[(head + count - 1) & mask] = move;
+    push_back(last);
+}
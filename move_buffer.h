@@ -0,0 +1,30 @@
+#ifndef _MOVE_BUFFER_H
+#define _MOVE_BUFFER_H
+
+#include <vector>
+#include "game.h"
+
+// A planned path of moves, kept in a ring so moves come off the front and paths are rebuilt from
+// either end without allocating once the ring is big enough
+class MoveBuffer {
+public:
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+    void clear() { head = count = 0; }
+    // Makes room for n moves at once, so later pushes up to that length don't allocate
+    void reserve(size_t n);
+
+    const Move &front() const { return ring[head]; }
+    const Move &back() const { return ring[(head + count - 1) & mask]; }
+    void push_front(const Move &move);
+    void push_back(const Move &move);
+    void pop_front();
+    // Puts move just before the last one
+    void insert_before_back(const Move &move);
+
+private:
+    std::vector<Move> ring; // its size is zero or a power of two
+    size_t head = 0, count = 0, mask = 0;
+};
+
+#endif //_MOVE_BUFFER_H
@@ -1,37 +1,332 @@
 #ifndef _ROBOT_AGENT_H
 #define _ROBOT_AGENT_H
 
-#include <set>
-#include <list>
-#include <functional>
+#include <array>
+#include <cmath>
+#include <stdexcept>
 #include "game.h"
 #include "logic_engine.h"
+#include "distance_field.h"
+#include "move_buffer.h"
+#include "alloc_check.h"
 
-class RobotAgent : public Game {
+// Target policies decide where the robot explores once no gold, Wumpus or way home is known.
+// The agent keeps one for the whole game, and its choose fills the agent's path and returns
+// false when there is nowhere left to go.
+
+// Explores the closest unvisited safe cell, and failing that the cell most likely to be safe
+struct NearestSafeTarget {
+    static inline const std::vector<CELL> harmless = {GOLD, EMPTY}; // made before any game starts
+
+    template<class Agent>
+    static bool choose(Agent &agent) {
+        // find path to a new, safe cell
+        if(agent.find_path(agent.wX, agent.wY, [&agent](int x, int y) { return agent.new_safe(x, y); }))
+            return true;
+
+        // No great options, but pick the best one
+        std::pair<int, int> loc;
+        if(agent.logic.highest_prob(harmless, loc)) {
+            agent.find_path_to_location(loc.first, loc.second);
+            return true;
+        }
+        return false;
+    }
+};
+
+// Explores the unvisited safe cell whose percepts are expected to tell the most about the keys the
+// engine already holds, per step of travel. Its breeze, stench and glitter each answer a yes or
+// no question about its neighbors. A cell next to rooms the engine has never heard of would widen
+// the tree, so those wait until no cell is left that only settles the engine's keys, and then the
+// nearest is explored, as RobotAgent would. The engine therefore never holds more rooms than
+// exploring nearest first brings in. The chances come from one sweep of the engine's odds,
+// shared by all the candidates.
+class InformationGainTarget {
 public:
-    RobotAgent() : Game(false) {}
+    template<class Agent>
+    bool choose(Agent &agent) {
+        DistanceField &field = agent.field;
+        if(candidates.capacity() < (size_t)field.num_passable()) {
+            AllocationCheck::Exempt growth; // the explored area
+            candidates.reserve(2 * field.num_passable());
+        }
+        candidates.clear();
+        field.set_source(agent.wX, agent.wY);
+        field.for_each_reached([this, &field](int x, int y, int distance) {
+            if(!field.visited(x, y)) candidates.push_back({{x, y}, distance, (int)candidates.size()});
+        });
+        if(candidates.empty()) { // no safe cell left, so risk the likeliest one
+            std::pair<int, int> loc;
+            if(!agent.logic.highest_prob(NearestSafeTarget::harmless, loc)) return false;
+            agent.find_path_to_location(loc.first, loc.second);
+            return true;
+        }
+        std::sort(candidates.begin(), candidates.end(),
+            [](const Candidate &a, const Candidate &b) { return a.cell < b.cell; });
+
+        // every neighbor starts out unseen, unless it is already known
+        for(Candidate &c : candidates) {
+            for(const std::pair<int, int> &n : neighbors(c.cell)) {
+                if(!agent.is_valid_cell(n.first, n.second) || agent.safe(n.first, n.second)) continue;
+                bool known = false;
+                for(int i = 0; i < NUM_SENSED; ++i) {
+                    if(agent.logic.is_true(n, sensed[i])) known = c.certain[i] = true;
+                }
+                if(!known) ++c.unseen;
+            }
+        }
+
+        // one pass over the engine's odds reaches every candidate next to each key. There is one
+        // Wumpus and one gold, so their chances next to a cell add up, while pits fall independently.
+        agent.logic.for_each_odds(sensed, [this](const std::pair<int, int> &key, int i, double odds) {
+            for(const std::pair<int, int> &n : neighbors(key)) {
+                Candidate *c = find(n);
+                if(!c) continue;
+                if(i == 0) c->none[i] *= 1 - odds;
+                else c->none[i] -= odds;
+                if(i == 0) --c->unseen;
+            }
+        });
+
+        const Candidate *best = nullptr, *nearest = nullptr;
+        double best_score = 0;
+        for(Candidate &c : candidates) {
+            if(!nearest || c.rank < nearest->rank) nearest = &c;
+            if(c.unseen > 0) continue;
+            double gain = 0;
+            for(int i = 0; i < NUM_SENSED; ++i)
+                if(!c.certain[i]) gain += entropy(std::max(0.0, c.none[i]));
+            double score = gain / c.distance;
+            if(score > 0 && (!best || score > best_score || (score == best_score && c.rank < best->rank))) {
+                best = &c;
+                best_score = score;
+            }
+        }
+        if(!best) best = nearest;
+        agent.find_path_to_location(best->cell.first, best->cell.second);
+        return true;
+    }
+
+private:
+    static constexpr int NUM_SENSED = 3;
+    static inline const std::vector<CELL> sensed = {PIT, WUMPUS, GOLD}; // breeze, stench, glitter
+
+    struct Candidate {
+        std::pair<int, int> cell;
+        int distance, rank; // rank is the order the field reached it in, which breaks ties
+        double none[NUM_SENSED] = {1, 1, 1}; // the chance the engine's keys next to it don't set off each
+        bool certain[NUM_SENSED] = {};
+        int unseen = 0; // neighbors that are neither known nor in the engine
+    };
+
+    std::vector<Candidate> candidates; // sorted by cell while scoring
+
+    static std::array<std::pair<int, int>, 4> neighbors(const std::pair<int, int> &cell) {
+        return {{{cell.first, cell.second + 1}, {cell.first, cell.second - 1},
+            {cell.first + 1, cell.second}, {cell.first - 1, cell.second}}};
+    }
+
+    Candidate *find(const std::pair<int, int> &cell) {
+        auto itr = std::lower_bound(candidates.begin(), candidates.end(), cell,
+            [](const Candidate &c, const std::pair<int, int> &cell_) { return c.cell < cell_; });
+        return itr != candidates.end() && itr->cell == cell ? &*itr : nullptr;
+    }
+
+    // The information in a yes or no answer that is no with the given chance, in bits
+    static double entropy(double p) {
+        if(p <= 0 || p >= 1) return 0;
+        return -p * std::log2(p) - (1 - p) * std::log2(1 - p);
+    }
+};
+
+// The logical robot, with its inference engine and target policy fixed at compile time so that
+// the game loop, the policy and the pathfinding predicates are all direct calls. Apart from the
+// engine and the growth of the explored area, a move allocates nothing, which builds made with
+// -DCHECK_ALLOCATIONS check on every move.
+template<class Engine, class Target>
+class BasicRobotAgent : public StaticGame<BasicRobotAgent<Engine, Target>> {
+public:
+    // A pit_density between 0 and 1 weighs unknown cells by that prior chance of holding a pit
+    explicit BasicRobotAgent(double pit_density_ = 0) : StaticGame<BasicRobotAgent>(false), pit_density(pit_density_) {}
 
 protected:
-    std::list<Move> path;
-    LogicEngine<std::pair<int, int>, CELL> logic;
-    std::set<std::pair<int, int>> visited;
+    friend StaticGame<BasicRobotAgent>;
+    friend Target;
+
+    Target target;
+    MoveBuffer path;
+    Engine logic;
+    ConstraintTransaction<std::pair<int, int>, CELL> percepts; // reused for every move
+    DistanceField field; // also marks the visited cells
+    size_t known_seen;
     Sense sense;
     int sX, sY, wX, wY;
+    double pit_density;
+
+    void start(int sizeX, int sizeY) override {
+        sX = sizeX;
+        sY = sizeY;
+        wX = wY = 0;
+        path.clear();
+        percepts.reserve(8, 4); // a move's percepts name at most the four neighbors
+        logic = Engine({CELL::EMPTY, CELL::PIT, CELL::WUMPUS, CELL::GOLD});
+        if(pit_density > 0) logic.set_density(CELL::PIT, pit_density);
+        field.start(sizeX, sizeY);
+        known_seen = 0;
+    }
+
+    Move choose_move(const Sense &sense_) override {
+        AllocationCheck check;
+        sense = sense_;
+        std::pair<int, int> loc;
+        if(sense.just_killed_wumpus && logic.find_by_state(WUMPUS, loc)) // only a known Wumpus is shot
+            logic.set_known(loc, EMPTY);
+        if(path.empty()) {
+            update_info();
+            choose_target();
+        }
+        Move move = follow_path();
+        check.expect_none("RobotAgent::choose_move");
+        return move;
+    }
+
+    // The cells next to one cell, in a fixed array
+    class Neighbors {
+    public:
+        std::array<std::pair<int, int>, 4> cells;
+        int count = 0;
+        const std::pair<int, int> *begin() const { return cells.data(); }
+        const std::pair<int, int> *end() const { return cells.data() + count; }
+    };
 
-    void start(int sizeX, int sizeY) override;
-    Move choose_move(const Sense &sense_) override;
+    void update_info() {
+        // everything this move tells us goes to the engine at once
+        percepts.clear();
+        percepts.constrain_all_of({{wX, wY}}, CELL::EMPTY);
 
-    void update_info();
-    Move follow_path();
-    void choose_target();
+        Neighbors locs;
+        if(is_valid_cell(wX, wY + 1)) locs.cells[locs.count++] = {wX, wY + 1};
+        if(is_valid_cell(wX, wY - 1)) locs.cells[locs.count++] = {wX, wY - 1};
+        if(is_valid_cell(wX + 1, wY)) locs.cells[locs.count++] = {wX + 1, wY};
+        if(is_valid_cell(wX - 1, wY)) locs.cells[locs.count++] = {wX - 1, wY};
 
-    bool find_path_to_location(int x, int y);
-    bool find_path(int startX, int startY, const std::function<bool(int, int)> &is_target);
+        if(sense.stench) {
+            percepts.constrain_one_of(locs, CELL::WUMPUS);
+            percepts.constrain_one_of(CELL::WUMPUS);
+        } else percepts.constrain_none_of(locs, CELL::WUMPUS);
 
-    static void add_direction(int &x, int &y, DIRECTION dir);
-    bool is_valid_cell(int x, int y) const;
-    bool safe(int x, int y);
-    bool new_safe(int x, int y);
+        if(sense.glitter) {
+            percepts.constrain_one_of(locs, CELL::GOLD);
+            percepts.constrain_one_of(CELL::GOLD);
+        } else percepts.constrain_none_of(locs, CELL::GOLD);
+
+        if(sense.breeze) percepts.constrain_at_least_one_of(locs, CELL::PIT);
+        else percepts.constrain_none_of(locs, CELL::PIT);
+
+        // the engine exempts its own growth, so anything else committing allocates is caught
+        if(sense.just_found_gold) logic.set_known({wX, wY}, EMPTY);
+        logic.commit(percepts);
+
+        AllocationCheck::Exempt growth; // the explored area
+        // the safe set only grows, so the field only needs the cells proven empty since last time
+        const std::vector<std::pair<int, int>> &known = logic.known_order();
+        for(; known_seen < known.size(); ++known_seen)
+            if(safe(known[known_seen].first, known[known_seen].second))
+                field.add_passable(known[known_seen].first, known[known_seen].second);
+        field.mark_visited(wX, wY);
+        path.reserve(field.num_passable() + 2); // the longest path crosses every passable cell
+    }
+
+    Move follow_path() {
+        if(path.empty()) throw std::runtime_error("The robot can't reach the cell it chose!");
+        Move move = path.front();
+        if(!move.shoot) add_direction(wX, wY, move.dir);
+
+        path.pop_front();
+        return move;
+    }
+
+    // Takes back a late move and steps to a neighbor known to be safe instead. The plan stays, so
+    // the robot steps back and makes the late move again. Shots are only accounted for once the
+    // Wumpus is reported dead, so a late one has nothing to take back.
+    Move replace_late_move(const Move &late) override {
+        if(!late.shoot) add_direction(wX, wY, opposite(late.dir));
+        Move move = Game::replace_late_move(late);
+        for(DIRECTION dir : {DIRECTION::UP, DIRECTION::RIGHT, DIRECTION::DOWN, DIRECTION::LEFT}) {
+            int x = wX, y = wY;
+            add_direction(x, y, dir);
+            if(is_valid_cell(x, y) && safe(x, y)) {
+                move = Game::walk(dir);
+                break;
+            }
+        }
+        add_direction(wX, wY, move.dir);
+        path.push_front(late);
+        path.push_front(Game::walk(opposite(move.dir)));
+        return move;
+    }
+
+    void choose_target() {
+        path.clear();
+        std::pair<int, int> loc;
+
+        if(sense.just_found_gold) { // navigate back
+            find_path_to_location(0, 0);
+            return;
+        }
+
+        if(logic.find_by_state(GOLD, loc)) { // navigate to gold
+            find_path_to_location(loc.first, loc.second);
+            return;
+        }
+
+        if(logic.find_by_state(WUMPUS, loc)) { // hunt the wumpus
+            find_path_to_location(loc.first, loc.second);
+            path.insert_before_back(Game::shoot(path.back().dir));
+            return;
+        }
+
+        if(target.choose(*this)) return;
+
+        // No possible safe options
+        throw std::runtime_error("This game is rigged!");
+    }
+
+    bool find_path_to_location(int x, int y) {
+        return find_path(wX, wY, [x, y](int x_, int y_) { return x_ == x && y_ == y; });
+    }
+
+    template<class Predicate>
+    bool find_path(int startX, int startY, const Predicate &is_target) {
+        field.set_source(startX, startY);
+        return field.find_path(is_target, path);
+    }
+
+    static DIRECTION opposite(DIRECTION dir) {
+        return (DIRECTION)((dir + 2) % 4);
+    }
+
+    static void add_direction(int &x, int &y, DIRECTION dir) {
+        if(dir == DIRECTION::UP) ++y;
+        else if(dir == DIRECTION::DOWN) --y;
+        else if(dir == DIRECTION::RIGHT) ++x;
+        else if(dir == DIRECTION::LEFT) --x;
+        else assert(false);
+    }
+
+    bool is_valid_cell(int x, int y) const {
+        return !(x < 0 || y < 0 || x >= sX || y >= sY);
+    }
+
+    bool safe(int x, int y) {
+        return logic.is_true({x, y}, CELL::EMPTY);
+    }
+
+    bool new_safe(int x, int y) {
+        return !field.visited(x, y) && safe(x, y);
+    }
 };
 
+typedef BasicRobotAgent<LogicEngine<std::pair<int, int>, CELL>, NearestSafeTarget> RobotAgent;
+
 #endif //_ROBOT_AGENT_H
@@ -0,0 +1,132 @@
+#include <fstream>
+#include <vector>
+#include <cassert>
+#include "world.h"
+
+bool World::load(const std::string &fileName, std::string &error) {
+    tiles.clear();
+    generated = false;
+    std::ifstream stream(fileName);
+    if(!stream.good()) {
+        error = "Can't open " + fileName + " to read.";
+        return false;
+    }
+
+    // rows are numbered from the top of the file, so the cells are placed once the height is known
+    std::vector<std::string> rows;
+    std::string s;
+    CELL cell = CELL::EMPTY;
+    while(stream >> s) {
+        for(char c: s) {
+            if(!to_cell(c, cell)) {
+                error = fileName + " has an unknown room '" + std::string(1, c) + "'.";
+                return false;
+            }
+        }
+        if(!rows.empty() && s.size() != rows[0].size()) {
+            error = fileName + " isn't a rectangle.";
+            return false;
+        }
+        rows.push_back(s);
+    }
+    if(rows.empty()) {
+        error = fileName + " has no rooms.";
+        return false;
+    }
+
+    width = (int)rows[0].size();
+    height = (int)rows.size();
+    for(int row = 0; row < height; ++row) {
+        for(int x = 0; x < width; ++x) {
+            to_cell(rows[row][x], cell);
+            if(cell != CELL::EMPTY) set(x, height - 1 - row, cell);
+        }
+    }
+    return true;
+}
+
+void World::generate(int sizeX, int sizeY, unsigned seed_, double pit_density_) {
+    assert(sizeX > 0 && sizeY > 0);
+    tiles.clear();
+    generated = true;
+    width = sizeX;
+    height = sizeY;
+    seed = seed_;
+    pit_density = pit_density_;
+
+    // anywhere but the start and its neighbors, when the world is big enough to allow it
+    auto place = [this](int salt, int &x, int &y) {
+        for(int tries = 0; tries < 64; ++tries) {
+            x = (int)(noise(seed + salt, tries, 0) * width);
+            y = (int)(noise(seed + salt, tries, 1) * height);
+            if(x + y > 1) return;
+        }
+    };
+    place(1, wumpusX, wumpusY);
+    for(int salt = 2; salt < 64; ++salt) {
+        place(salt, goldX, goldY);
+        if(goldX != wumpusX || goldY != wumpusY) break;
+    }
+}
+
+CELL World::get(int x, int y) const {
+    if(x < 0 || y < 0 || x >= width || y >= height)
+        return WALL;
+    tile *t = find_tile(x, y, generated);
+    if(!t) return EMPTY;
+    return (CELL)(*t)[(y % TILE) * TILE + (x % TILE)];
+}
+
+void World::set(int x, int y, CELL c) {
+    assert(!(x < 0 || y < 0 || x >= width || y >= height));
+    tile *t = find_tile(x, y, generated || c != EMPTY);
+    if(t) (*t)[(y % TILE) * TILE + (x % TILE)] = (unsigned char)c;
+}
+
+World::tile* World::find_tile(int x, int y, bool create) const {
+    int tx = x / TILE, ty = y / TILE;
+    auto itr = tiles.find(tile_key(tx, ty));
+    if(itr != tiles.end()) return &itr->second;
+    if(!create) return nullptr;
+    tile &t = tiles[tile_key(tx, ty)];
+    t.fill(EMPTY);
+    if(generated) fill_tile(t, tx, ty);
+    return &t;
+}
+
+void World::fill_tile(tile &t, int tx, int ty) const {
+    for(int dy = 0; dy < TILE; ++dy) {
+        for(int dx = 0; dx < TILE; ++dx) {
+            int x = tx * TILE + dx, y = ty * TILE + dy;
+            CELL c = EMPTY;
+            if(x == wumpusX && y == wumpusY) c = WUMPUS;
+            else if(x == goldX && y == goldY) c = GOLD;
+            else if(x + y > 1 && noise(seed, x, y) < pit_density) c = PIT;
+            t[dy * TILE + dx] = (unsigned char)c;
+        }
+    }
+}
+
+bool World::to_cell(char c, CELL &cell) {
+    if(c == 'E') cell = CELL::EMPTY;
+    else if(c == 'P') cell = CELL::PIT;
+    else if(c == 'W') cell = CELL::WUMPUS;
+    else if(c == 'G') cell = CELL::GOLD;
+    else return false;
+    return true;
+}
+
+long long World::tile_key(int tx, int ty) {
+    return ((long long)tx << 32) | (unsigned)ty;
+}
+
+// A uniform number in [0, 1) that depends only on its arguments
+double World::noise(unsigned seed, int x, int y) {
+    unsigned long long h = ((unsigned long long)seed << 32) ^ ((unsigned long long)(unsigned)x << 16) ^ (unsigned)y;
+    h ^= (unsigned long long)(unsigned)x * 0x9E3779B97F4A7C15ULL;
+    h += 0x9E3779B97F4A7C15ULL;
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+    h ^= h >> 31;
+    return (double)(h >> 11) / (double)(1ULL << 53);
+}
@@ -0,0 +1,50 @@
+#ifndef _WORLD_H
+#define _WORLD_H
+
+#include <string>
+#include <array>
+#include <unordered_map>
+
+// The contents of a square in the world
+enum CELL { EMPTY, PIT, WUMPUS, GOLD, WALL };
+
+// The rooms of a world, kept in 16x16 tiles that only exist where something is stored. A loaded
+// world keeps just the tiles holding a hazard or the gold. A generated world creates each tile
+// from its seed the first time it is looked at, so huge worlds start at once and take memory
+// in proportion to the area explored.
+class World {
+public:
+    World() : width(0), height(0), seed(0), pit_density(0), generated(false) {}
+
+    // Reads a world where 'E' is an empty room, 'P' a pit, 'W' the Wumpus and 'G' the gold.
+    // Returns false and sets error if the file can't be read.
+    bool load(const std::string &fileName, std::string &error);
+
+    // Makes a world whose pits, Wumpus and gold follow from the seed. The start and
+    // the two rooms next to it are always empty.
+    void generate(int sizeX, int sizeY, unsigned seed_, double pit_density_);
+
+    CELL get(int x, int y) const; // WALL outside the world
+    void set(int x, int y, CELL c);
+    int sizeX() const { return width; }
+    int sizeY() const { return height; }
+
+private:
+    static constexpr int TILE = 16;
+    typedef std::array<unsigned char, TILE * TILE> tile;
+
+    int width, height;
+    unsigned seed;
+    double pit_density;
+    bool generated;
+    int wumpusX, wumpusY, goldX, goldY;
+    mutable std::unordered_map<long long, tile> tiles; // generated tiles are filled in on first access
+
+    tile* find_tile(int x, int y, bool create) const;
+    void fill_tile(tile &t, int tx, int ty) const;
+    static bool to_cell(char c, CELL &cell);
+    static long long tile_key(int tx, int ty);
+    static double noise(unsigned seed, int x, int y);
+};
+
+#endif //_WORLD_H